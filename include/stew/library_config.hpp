@@ -22,6 +22,9 @@
 #include <stew/stew_api.hpp>
 #include <stew/log/trace.hpp>
 
+#include <string>
+#include <vector>
+
 namespace stew
 {
 
@@ -32,12 +35,46 @@ struct STEW_API LibraryArguments
     struct STEW_API ThreadPool
     {
         std::size_t threadCount = std::thread::hardware_concurrency();
+        stew::ThreadPool::SchedulingMode schedulingMode = stew::ThreadPool::SchedulingMode::SharedQueue;
+        std::chrono::nanoseconds priorityAging = std::chrono::milliseconds(100);
+        std::size_t maxThreadCount = 0u;
+        std::chrono::nanoseconds spawnLatency = std::chrono::milliseconds(10);
+        std::chrono::nanoseconds keepAlive = std::chrono::seconds(1);
+        std::size_t maxCompensatingThreadCount = std::thread::hardware_concurrency();
+        stew::ThreadPool::AffinityPolicy affinityPolicy = stew::ThreadPool::AffinityPolicy::None;
+        std::vector<std::size_t> affinityCpus;
+        std::size_t queueCapacity = 0u;
+        stew::ThreadPool::OverflowPolicy overflowPolicy = stew::ThreadPool::OverflowPolicy::Reject;
+        std::chrono::nanoseconds blockTimeout = std::chrono::milliseconds(100);
+        std::size_t idleSpinCount = 100u;
+        std::size_t idleYieldCount = 10u;
+        std::size_t nextJobSlotLimit = 3u;
+        stew::ThreadPool::MissedDeadlinePolicy missedDeadlinePolicy = stew::ThreadPool::MissedDeadlinePolicy::Skip;
+        JobPriority threadPriority = JobPriority::Normal;
         bool createThreadPool = true;
     } threadPool;
 
+    /// A named thread pool of the library, next to the default thread pool. The thread pools of the
+    /// executors are only created when the library creates its thread pool, otherwise the executors run
+    /// their jobs on the calling thread.
+    struct STEW_API Executor
+    {
+        std::string name;
+        std::size_t threadCount = 1u;
+        stew::ThreadPool::SchedulingMode schedulingMode = stew::ThreadPool::SchedulingMode::SharedQueue;
+        stew::ThreadPool::AffinityPolicy affinityPolicy = stew::ThreadPool::AffinityPolicy::None;
+        std::vector<std::size_t> affinityCpus;
+        JobPriority threadPriority = JobPriority::Normal;
+    };
+    std::vector<Executor> executors;
+
     struct STEW_API Tracer
     {
         LogLevel logLevel = LogLevel::Debug;
+        /// The executor which flushes the logs. If the executors do not declare it, the library creates
+        /// it with a single background priority thread. Leave it empty to flush the logs on the thread
+        /// pool of the library.
+        std::string executor = "tracer";
     } tracer;
 
     explicit LibraryArguments() = default;
@@ -37,6 +37,16 @@ namespace stew
 /// A generic signal is activated using the trigger() method. When a signal is activated, its connected
 /// slots get invoked. Connections created within an activated slot is left out from the current signal
 /// activation.
+///
+/// The slots are invoked on the thread which triggers the signal. To run the work of a slot on a
+/// thread pool, call async() from the slot, either with the name of an executor of the library, or with
+/// the thread pool handle.
+/// \code
+/// auto slot = [](std::string path)
+/// {
+///     stew::async("io", [path]() { writeFile(path); });
+/// };
+/// \endcode
 class STEW_API SignalExtension : public ObjectExtension
 {
 public:
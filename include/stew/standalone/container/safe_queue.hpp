@@ -22,8 +22,12 @@
 #include <stew/standalone/container/detail/safe_queue.hpp>
 #include <stew/stew_api.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 
 namespace stew
@@ -69,6 +73,57 @@ public:
     }
 };
 
+/// A bounded lock-free queue with multiple producers and multiple consumers. Each slot of the queue
+/// carries a sequence number, which tells whether the slot is free to push to, or ready to pop from,
+/// so the producers and the consumers only contend on the position they advance.
+/// \tparam ElementType The element type. The type must be default constructible and movable.
+template <class ElementType>
+class STEW_TEMPLATE_API MpmcQueue
+{
+    struct Slot
+    {
+        std::atomic_size_t sequence = 0u;
+        ElementType element = {};
+    };
+    // Keeps the positions on separate cache lines, so the producers do not invalidate the line of the
+    // consumers.
+    static constexpr std::size_t CacheLineSize = 64u;
+
+    std::unique_ptr<Slot[]> m_slots;
+    const std::size_t m_mask = 0u;
+    alignas(CacheLineSize) std::atomic_size_t m_pushPosition = 0u;
+    alignas(CacheLineSize) std::atomic_size_t m_popPosition = 0u;
+
+public:
+    /// Constructor. Creates a queue with a capacity, rounded up to the next power of two.
+    /// \param capacity The capacity of the queue.
+    explicit MpmcQueue(std::size_t capacity);
+
+    /// Returns the capacity of the queue.
+    /// \return The capacity of the queue.
+    std::size_t getCapacity() const
+    {
+        return m_mask + 1u;
+    }
+
+    /// Tries to push an element into the queue. On success, the element gets moved into the queue.
+    /// \param element The element to push into the queue.
+    /// \return On success, returns \e true. If the queue is full, returns \e false.
+    bool tryPush(ElementType&& element);
+
+    /// Tries to pop the element at the head of the queue.
+    /// \return The element at head on success, or an invalid element when the queue is empty.
+    ElementType tryPop();
+
+    /// Returns whether the queue was empty at the time of the call. The queue may have received
+    /// content right after the call.
+    /// \return If the queue was empty, returns \e true, otherwise \e false.
+    bool wasEmpty() const
+    {
+        return m_popPosition.load(std::memory_order_acquire) == m_pushPosition.load(std::memory_order_acquire);
+    }
+};
+
 /// A shared, thread safe dynamic queue of elements. The queue gets locked on every push and pop call.
 /// \tparam ElementType The type of an element of the shared queue.
 /// \tparam Notifier The notifier of the shared queue. The notifier is expected to have the following
@@ -165,6 +220,81 @@ ElementType CircularBuffer<ElementType, Size>::tryPop()
 }
 
 
+template <class ElementType>
+MpmcQueue<ElementType>::MpmcQueue(std::size_t capacity) :
+    m_slots(new Slot[std::bit_ceil(std::max(capacity, std::size_t(2u)))]),
+    m_mask(std::bit_ceil(std::max(capacity, std::size_t(2u))) - 1u)
+{
+    for (std::size_t i = 0u; i <= m_mask; ++i)
+    {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <class ElementType>
+bool MpmcQueue<ElementType>::tryPush(ElementType&& element)
+{
+    auto position = m_pushPosition.load(std::memory_order_relaxed);
+    while (true)
+    {
+        auto& slot = m_slots[position & m_mask];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+        if (difference == 0)
+        {
+            // The slot is free, claim it.
+            if (m_pushPosition.compare_exchange_weak(position, position + 1u, std::memory_order_relaxed))
+            {
+                slot.element = std::move(element);
+                slot.sequence.store(position + 1u, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The slot still holds the element of the previous lap: full.
+            return false;
+        }
+        else
+        {
+            position = m_pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <class ElementType>
+ElementType MpmcQueue<ElementType>::tryPop()
+{
+    auto position = m_popPosition.load(std::memory_order_relaxed);
+    while (true)
+    {
+        auto& slot = m_slots[position & m_mask];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1u);
+        if (difference == 0)
+        {
+            // The slot is ready, claim it.
+            if (m_popPosition.compare_exchange_weak(position, position + 1u, std::memory_order_relaxed))
+            {
+                auto element = std::move(slot.element);
+                slot.element = {};
+                slot.sequence.store(position + m_mask + 1u, std::memory_order_release);
+                return element;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The slot is not yet written: empty.
+            return {};
+        }
+        else
+        {
+            position = m_popPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
 template <class ElementType, class Notifier>
 void SharedQueue<ElementType, Notifier>::push(ElementType element)
 {
@@ -55,6 +55,18 @@ public:
     ///         a thread pool.
     ThreadPool* threadPool() const;
 
+    /// Returns a named executor of the library.
+    /// \param name The name of the executor.
+    /// \return The thread pool of the executor, or nullptr, if the library has no executor with the
+    ///         name, or the library is initialized without a thread pool.
+    ThreadPool* executor(std::string_view name) const;
+
+    /// Returns whether the library has a named executor. A library initialized without a thread pool
+    /// has the executors it got initialized with, and they run their jobs on the calling thread.
+    /// \param name The name of the executor.
+    /// \return If the library has an executor with the name, returns \e true, otherwise \e false.
+    bool hasExecutor(std::string_view name) const;
+
     /// Returns the tracer of the library. The method is only available when tracing is eanbled.
     /// \return The tracer of the library.
     Tracer* tracer() const;
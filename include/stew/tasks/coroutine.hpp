@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_COROUTINE_HPP
+#define STEW_COROUTINE_HPP
+
+#include <stew/core/assert.hpp>
+#include <stew/stew.hpp>
+#include <stew/tasks/future.hpp>
+#include <stew/tasks/job.hpp>
+#include <stew/tasks/thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <future>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace stew
+{
+
+namespace detail
+{
+
+/// Returns the thread pool on which an awaiting coroutine resumes: the thread pool of the calling
+/// thread, or the thread pool of the library.
+inline ThreadPool* getResumePool()
+{
+    auto pool = ThreadPool::getCurrent();
+    return pool ? pool : Library::instance().threadPool();
+}
+
+/// The task which resumes a suspended coroutine on a thread pool. A coroutine is resumed only once.
+/// If the thread pool rejects or cancels the task, the coroutine resumes on the cancelling thread, and
+/// the awaiter of the coroutine gets notified about the cancellation.
+class STEW_TEMPLATE_API ResumeTask : public AsyncTaskBase
+{
+public:
+    explicit ResumeTask(ThreadPool* pool, std::coroutine_handle<> handle, bool& cancelled) :
+        AsyncTaskBase(pool),
+        m_handle(handle),
+        m_cancelled(cancelled)
+    {
+    }
+
+    /// Resumes a coroutine on a thread pool. Without a thread pool, resumes the coroutine on the
+    /// calling thread.
+    static void resume(ThreadPool* pool, std::coroutine_handle<> handle, bool& cancelled)
+    {
+        dispatch(std::make_shared<ResumeTask>(pool, handle, cancelled));
+    }
+
+    /// Resumes the coroutine, unless it is already resumed.
+    void tryResume(bool cancelled)
+    {
+        if (m_resumed.exchange(true))
+        {
+            return;
+        }
+        m_cancelled = cancelled;
+        m_handle.resume();
+    }
+
+protected:
+    void schedule() override
+    {
+        tryResume(false);
+    }
+    void cancel() override
+    {
+        tryResume(true);
+    }
+
+private:
+    std::coroutine_handle<> m_handle;
+    bool& m_cancelled;
+    std::atomic_bool m_resumed = false;
+};
+
+/// The base of the awaiters which resume the awaiting coroutine on a thread pool.
+class STEW_TEMPLATE_API ResumingAwaiter
+{
+protected:
+    /// Throws a std::future_error with broken promise, if the thread pool cancelled the resumption.
+    void checkCancelled() const
+    {
+        if (m_cancelled)
+        {
+            throw std::future_error(std::future_errc::broken_promise);
+        }
+    }
+
+    bool m_cancelled = false;
+};
+
+/// The awaiter which moves a coroutine to a thread pool.
+class STEW_TEMPLATE_API ScheduleAwaiter : public ResumingAwaiter
+{
+public:
+    explicit ScheduleAwaiter(ThreadPool* pool) :
+        m_pool(pool)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return !m_pool || ThreadPool::getCurrent() == m_pool;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        ResumeTask::resume(m_pool, handle, m_cancelled);
+    }
+    void await_resume() const
+    {
+        checkCancelled();
+    }
+
+private:
+    ThreadPool* m_pool = nullptr;
+};
+
+/// The awaiter which resumes a coroutine when a job settles.
+class STEW_TEMPLATE_API JobAwaiter : public ResumingAwaiter
+{
+public:
+    explicit JobAwaiter(JobPtr job) :
+        m_job(std::move(job))
+    {
+        abortIfFail(m_job);
+    }
+
+    bool await_ready() const
+    {
+        return !m_job->isBusy();
+    }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        auto pool = getResumePool();
+        // Touch no member after the handler is added, as the handler may resume the coroutine
+        // before this call returns.
+        return m_job->addCompletionHandler([this, pool, handle](Job::Status status)
+        {
+            m_status = status;
+            ResumeTask::resume(pool, handle, m_cancelled);
+        });
+    }
+    Job::Status await_resume() const
+    {
+        checkCancelled();
+        return m_status.value_or(m_job->getStatus());
+    }
+
+private:
+    JobPtr m_job;
+    std::optional<Job::Status> m_status;
+};
+
+/// The timed job which resumes a coroutine on a thread of a pool. If the job gets stopped, the
+/// coroutine resumes on the stopping thread, and its awaiter gets notified about the cancellation.
+class STEW_TEMPLATE_API DelayJob : public Job
+{
+public:
+    explicit DelayJob(std::coroutine_handle<> handle, bool& cancelled) :
+        m_resume(std::make_shared<ResumeTask>(nullptr, handle, cancelled))
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_resume->tryResume(false);
+    }
+    void stopOverride() override
+    {
+        m_resume->tryResume(true);
+    }
+
+private:
+    std::shared_ptr<ResumeTask> m_resume;
+};
+
+/// The awaiter which resumes a coroutine after a delay.
+class STEW_TEMPLATE_API DelayAwaiter : public ResumingAwaiter
+{
+public:
+    explicit DelayAwaiter(const std::chrono::nanoseconds& delay) :
+        m_delay(delay)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return m_delay.count() <= 0;
+    }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        auto pool = getResumePool();
+        if (!pool)
+        {
+            std::this_thread::sleep_for(m_delay);
+            return false;
+        }
+        if (!pool->scheduleAfter(std::make_shared<DelayJob>(handle, m_cancelled), m_delay))
+        {
+            m_cancelled = true;
+            return false;
+        }
+        return true;
+    }
+    void await_resume() const
+    {
+        checkCancelled();
+    }
+
+private:
+    std::chrono::nanoseconds m_delay;
+};
+
+/// The awaiter which resumes a coroutine when the result of a future is ready.
+template <typename Result>
+class STEW_TEMPLATE_API FutureAwaiter : public ResumingAwaiter
+{
+public:
+    explicit FutureAwaiter(Future<Result>& future) :
+        m_state(std::move(future.m_state))
+    {
+        abortIfFail(m_state);
+    }
+
+    bool await_ready() const
+    {
+        return m_state->isReady();
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_state->setContinuation(std::make_shared<ResumeTask>(getResumePool(), handle, m_cancelled));
+    }
+    Result await_resume()
+    {
+        checkCancelled();
+        return m_state->take();
+    }
+
+private:
+    typename Future<Result>::StatePtr m_state;
+};
+
+/// The shared state of a future returned by a coroutine. The coroutine sets the result of the state.
+template <typename Result>
+class STEW_TEMPLATE_API CoroutineState : public FutureState<Result>
+{
+public:
+    explicit CoroutineState(ThreadPool* pool) :
+        FutureState<Result>(pool)
+    {
+    }
+
+    /// Sets the result of the state from the return value or the exception of a function.
+    template <typename Function>
+    void settle(Function function)
+    {
+        this->resolve(function);
+    }
+
+protected:
+    void schedule() override
+    {
+    }
+};
+
+/// The common part of the promise types of the coroutines which return a future. The coroutines start
+/// on the calling thread, and run till their first suspension.
+template <typename Result>
+class STEW_TEMPLATE_API FuturePromiseBase
+{
+public:
+    Future<Result> get_return_object()
+    {
+        return Future<Result>(m_state);
+    }
+    std::suspend_never initial_suspend() const noexcept
+    {
+        return {};
+    }
+    std::suspend_never final_suspend() const noexcept
+    {
+        return {};
+    }
+    void unhandled_exception()
+    {
+        auto error = std::current_exception();
+        m_state->settle([error]() -> Result { std::rethrow_exception(error); });
+    }
+
+protected:
+    std::shared_ptr<CoroutineState<Result>> m_state = std::make_shared<CoroutineState<Result>>(getResumePool());
+};
+
+/// The promise type of the coroutines which return a future.
+template <typename Result>
+class STEW_TEMPLATE_API FuturePromise : public FuturePromiseBase<Result>
+{
+public:
+    template <typename Value>
+    void return_value(Value&& value)
+    {
+        this->m_state->settle([&value]() -> Result { return std::forward<Value>(value); });
+    }
+};
+
+template <>
+class STEW_TEMPLATE_API FuturePromise<void> : public FuturePromiseBase<void>
+{
+public:
+    void return_void()
+    {
+        m_state->settle([]() {});
+    }
+};
+
+} // namespace detail
+
+/// Moves the awaiting coroutine to a thread of a pool. If the coroutine already runs on a thread of
+/// the pool, the coroutine continues without suspension. If the thread pool rejects the coroutine,
+/// the coroutine resumes on the calling thread, and the awaiter throws a std::future_error with broken
+/// promise.
+/// \code
+/// stew::Future<void> process()
+/// {
+///     co_await stew::resumeOn(threadPool);
+///     // Runs on a thread of threadPool.
+/// }
+/// \endcode
+/// \param pool The thread pool to move the coroutine to. If \e nullptr, the coroutine moves to the
+///        thread pool of the library. If the library has no thread pool, the coroutine continues on
+///        the calling thread.
+/// \return The awaitable.
+inline detail::ScheduleAwaiter resumeOn(ThreadPool* pool)
+{
+    return detail::ScheduleAwaiter(pool ? pool : Library::instance().threadPool());
+}
+
+/// Suspends the awaiting coroutine for a delay, without blocking its thread. The coroutine resumes on
+/// a thread of the pool of the calling thread, or on a thread of the library pool. If the library has
+/// no thread pool, the calling thread sleeps for the delay. If the thread pool stops before the delay
+/// expires, the awaiter throws a std::future_error with broken promise.
+/// \param delay The delay.
+/// \return The awaitable.
+inline detail::DelayAwaiter delay(const std::chrono::nanoseconds& delay)
+{
+    return detail::DelayAwaiter(delay);
+}
+
+/// Suspends the awaiting coroutine till a job settles, without blocking its thread. The coroutine
+/// resumes on a thread of the pool of the calling thread, or on a thread of the library pool. If the
+/// job is not busy, the coroutine continues without suspension.
+/// \code
+/// auto status = co_await job;
+/// \endcode
+/// The awaiter returns the status the job settled with.
+inline detail::JobAwaiter operator co_await(JobPtr job)
+{
+    return detail::JobAwaiter(std::move(job));
+}
+
+/// Suspends the awaiting coroutine till the result of a future is ready, without blocking its thread.
+/// The awaiter takes the result of the future, or rethrows the exception of the future. The future
+/// loses its state. If the thread pool which resumes the coroutine stops before the result is ready,
+/// the awaiter throws a std::future_error with broken promise.
+template <typename Result>
+detail::FutureAwaiter<Result> operator co_await(Future<Result>& future)
+{
+    return detail::FutureAwaiter<Result>(future);
+}
+
+template <typename Result>
+detail::FutureAwaiter<Result> operator co_await(Future<Result>&& future)
+{
+    return detail::FutureAwaiter<Result>(future);
+}
+
+} // namespace stew
+
+/// A coroutine which returns a stew::Future<> runs till its first suspension on the calling thread,
+/// and stores its result or its exception in the future.
+template <typename Result, typename... Arguments>
+struct std::coroutine_traits<stew::Future<Result>, Arguments...>
+{
+    using promise_type = stew::detail::FuturePromise<Result>;
+};
+
+#endif // STEW_COROUTINE_HPP
@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_FUTURE_HPP
+#define STEW_FUTURE_HPP
+
+#include <stew/stew.hpp>
+#include <stew/tasks/thread_pool.hpp>
+
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+
+namespace stew
+{
+
+template <typename Result>
+class Future;
+
+namespace detail
+{
+
+template <typename Result>
+class FutureAwaiter;
+
+/// The base of the tasks executed by async() and Future<>::then().
+class STEW_TEMPLATE_API AsyncTaskBase : public ThreadPool::BaseJob
+{
+public:
+    /// Returns the thread pool of the task.
+    ThreadPool* getPool() const
+    {
+        return m_pool;
+    }
+
+    /// Schedules the task on its thread pool. If the task has no thread pool, runs the task on the
+    /// calling thread. If the thread pool rejects the task, cancels the task.
+    static void dispatch(std::shared_ptr<AsyncTaskBase> task)
+    {
+        if (!task->m_pool)
+        {
+            if (task->tryQueue())
+            {
+                task->schedule();
+                task->complete();
+            }
+            return;
+        }
+        if (!task->m_pool->tryScheduleTask(task))
+        {
+            task->cancel();
+        }
+    }
+
+    /// Cancels a task without scheduling it. The future of the task breaks its promise.
+    static void discard(std::shared_ptr<AsyncTaskBase> task)
+    {
+        task->cancel();
+    }
+
+protected:
+    explicit AsyncTaskBase(ThreadPool* pool) :
+        m_pool(pool)
+    {
+    }
+
+    /// A task is queued only once.
+    bool tryQueue() override
+    {
+        return !m_queued.exchange(true);
+    }
+    void complete() override
+    {
+    }
+
+private:
+    ThreadPool* m_pool = nullptr;
+    std::atomic_bool m_queued = false;
+};
+
+/// The shared state of a future. The state is also the task which produces the result.
+template <typename Result>
+class STEW_TEMPLATE_API FutureState : public AsyncTaskBase
+{
+    using ValueType = std::conditional_t<std::is_void_v<Result>, std::monostate, Result>;
+
+public:
+    /// Returns whether the result is ready.
+    bool isReady() const
+    {
+        return m_ready;
+    }
+
+    /// Waits till the result is ready. A thread of a pool runs the queued jobs of its pool meanwhile.
+    void wait() const
+    {
+        if (auto pool = ThreadPool::getCurrent())
+        {
+            pool->waitUntil([this]() { return m_ready.load(); });
+            return;
+        }
+        while (!m_ready)
+        {
+            m_ready.wait(false);
+        }
+    }
+
+    /// Waits for the result, and moves it out of the state. If the task failed, rethrows the
+    /// exception of the task.
+    Result take()
+    {
+        wait();
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+        if constexpr (!std::is_void_v<Result>)
+        {
+            return std::move(*m_value);
+        }
+    }
+
+    /// Sets the continuation of the state. The continuation is dispatched when the result is ready.
+    void setContinuation(std::shared_ptr<AsyncTaskBase> continuation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (!m_ready)
+            {
+                m_continuation = std::move(continuation);
+                return;
+            }
+        }
+        dispatch(std::move(continuation));
+    }
+
+protected:
+    using AsyncTaskBase::AsyncTaskBase;
+
+    /// Sets the result of the state, unless the state is already ready.
+    template <typename Setter>
+    void setResult(Setter setter)
+    {
+        std::shared_ptr<AsyncTaskBase> continuation;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_ready)
+            {
+                return;
+            }
+            setter();
+            m_ready = true;
+            continuation = std::move(m_continuation);
+        }
+        m_ready.notify_all();
+        ThreadPool::notifyWaiters();
+
+        if (continuation)
+        {
+            dispatch(std::move(continuation));
+        }
+    }
+
+    /// Runs the function, and stores its result or its exception.
+    template <typename Function>
+    void resolve(Function& function)
+    {
+        try
+        {
+            if constexpr (std::is_void_v<Result>)
+            {
+                function();
+                setResult([]() {});
+            }
+            else
+            {
+                auto value = function();
+                setResult([this, &value]() { m_value.emplace(std::move(value)); });
+            }
+        }
+        catch (...)
+        {
+            auto error = std::current_exception();
+            setResult([this, &error]() { m_error = error; });
+        }
+    }
+
+    /// A cancelled task breaks its promise.
+    void cancel() override
+    {
+        auto error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+        setResult([this, &error]() { m_error = error; });
+    }
+
+private:
+    std::mutex m_lock;
+    std::optional<ValueType> m_value;
+    std::exception_ptr m_error;
+    std::shared_ptr<AsyncTaskBase> m_continuation;
+    std::atomic_bool m_ready = false;
+};
+
+/// The task which invokes a function with its arguments, and stores the result in its state.
+template <typename Result, typename Function, typename... Arguments>
+class STEW_TEMPLATE_API AsyncTask : public FutureState<Result>
+{
+    Function m_function;
+    std::tuple<Arguments...> m_arguments;
+
+public:
+    template <typename FunctionType, typename... ArgumentTypes>
+    explicit AsyncTask(ThreadPool* pool, FunctionType&& function, ArgumentTypes&&... arguments) :
+        FutureState<Result>(pool),
+        m_function(std::forward<FunctionType>(function)),
+        m_arguments(std::forward<ArgumentTypes>(arguments)...)
+    {
+    }
+
+protected:
+    void schedule() override
+    {
+        if (this->isReady())
+        {
+            // Cancelled.
+            return;
+        }
+        auto invoker = [this]() -> Result
+        {
+            return std::apply(m_function, std::move(m_arguments));
+        };
+        this->resolve(invoker);
+    }
+};
+
+} // namespace detail
+
+/// A lightweight future, which holds the result of a function executed with async(). The future
+/// shares its state with the task which executes the function, so an asynchronous call costs a single
+/// allocation.
+///
+/// To chain a function to the result of a future, call then(). The chained function is executed on
+/// the thread pool of the future, once the result is ready.
+/// \tparam Result The result type of the future.
+template <typename Result>
+class STEW_TEMPLATE_API Future
+{
+public:
+    using StatePtr = std::shared_ptr<detail::FutureState<Result>>;
+
+    /// Constructs an invalid future.
+    Future() = default;
+    /// Constructs a future with a shared state.
+    explicit Future(StatePtr state) :
+        m_state(std::move(state))
+    {
+    }
+    Future(Future&&) = default;
+    Future& operator=(Future&&) = default;
+
+    /// Returns whether the future has a shared state. The future loses its state when you get its
+    /// result, or chain a function to it.
+    bool isValid() const
+    {
+        return static_cast<bool>(m_state);
+    }
+
+    /// Returns whether the result of the future is ready.
+    bool isReady() const
+    {
+        return m_state && m_state->isReady();
+    }
+
+    /// Waits till the result of the future is ready.
+    void wait() const
+    {
+        m_state->wait();
+    }
+
+    /// Waits for the result of the future, and returns it. If the function of the future throws, the
+    /// method rethrows the exception. If the thread pool stops before the function runs, the method
+    /// throws a std::future_error with broken promise.
+    /// \return The result of the future.
+    Result get()
+    {
+        auto state = std::move(m_state);
+        return state->take();
+    }
+
+    /// Chains a function to the future. The function receives the result of the future, and runs on
+    /// the thread pool of the future once the result is ready. If the future fails, the function is
+    /// not called, and the returned future fails with the same exception.
+    /// \tparam Function The function type to chain.
+    /// \param function The function to chain.
+    /// \return The future of the chained function.
+    template <typename Function>
+    auto then(Function&& function);
+
+private:
+    friend class detail::FutureAwaiter<Result>;
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    StatePtr m_state;
+};
+
+
+/// Executes a function with arguments asynchronously on a thread pool. If the thread pool is null,
+/// the function is executed on the calling thread.
+/// \tparam Function The function type.
+/// \tparam Arguments The argument types of the function.
+/// \param pool The thread pool which executes the function.
+/// \param function The function to execute.
+/// \param arguments The arguments to pass to the function.
+/// \return The future of the function result.
+template <typename Function, typename... Arguments>
+    requires std::invocable<std::decay_t<Function>&, std::decay_t<Arguments>...>
+auto async(ThreadPool* pool, Function&& function, Arguments&&... arguments)
+{
+    using Result = std::invoke_result_t<std::decay_t<Function>&, std::decay_t<Arguments>...>;
+    using Task = detail::AsyncTask<Result, std::decay_t<Function>, std::decay_t<Arguments>...>;
+
+    auto task = std::make_shared<Task>(pool, std::forward<Function>(function), std::forward<Arguments>(arguments)...);
+    Future<Result> future(task);
+    detail::AsyncTaskBase::dispatch(std::move(task));
+    return future;
+}
+
+/// Executes a function with arguments asynchronously on the thread pool of the library. If the
+/// library has no thread pool, the function is executed on the calling thread.
+/// \tparam Function The function type.
+/// \tparam Arguments The argument types of the function.
+/// \param function The function to execute.
+/// \param arguments The arguments to pass to the function.
+/// \return The future of the function result.
+template <typename Function, typename... Arguments>
+    requires std::invocable<std::decay_t<Function>&, std::decay_t<Arguments>...>
+auto async(Function&& function, Arguments&&... arguments)
+{
+    return async(Library::instance().threadPool(), std::forward<Function>(function), std::forward<Arguments>(arguments)...);
+}
+
+/// Executes a function with arguments asynchronously on a named executor of the library. If the
+/// library has no thread pool, the function is executed on the calling thread. If the library has no
+/// executor with the name, the function is not executed, and the returned future throws
+/// std::future_error with std::future_errc::broken_promise.
+/// \tparam Function The function type.
+/// \tparam Arguments The argument types of the function.
+/// \param executor The name of the executor.
+/// \param function The function to execute.
+/// \param arguments The arguments to pass to the function.
+/// \return The future of the function result.
+template <typename Function, typename... Arguments>
+    requires std::invocable<std::decay_t<Function>&, std::decay_t<Arguments>...>
+auto async(std::string_view executor, Function&& function, Arguments&&... arguments)
+{
+    if (!Library::instance().hasExecutor(executor))
+    {
+        using Result = std::invoke_result_t<std::decay_t<Function>&, std::decay_t<Arguments>...>;
+        using Task = detail::AsyncTask<Result, std::decay_t<Function>, std::decay_t<Arguments>...>;
+
+        auto task = std::make_shared<Task>(nullptr, std::forward<Function>(function), std::forward<Arguments>(arguments)...);
+        Future<Result> future(task);
+        detail::AsyncTaskBase::discard(std::move(task));
+        return future;
+    }
+    return async(Library::instance().executor(executor), std::forward<Function>(function), std::forward<Arguments>(arguments)...);
+}
+
+
+// ----- Implementation -----
+template <typename Result>
+template <typename Function>
+auto Future<Result>::then(Function&& function)
+{
+    auto antecedent = std::move(m_state);
+    auto continuation = [antecedent, function = std::forward<Function>(function)]() mutable
+    {
+        if constexpr (std::is_void_v<Result>)
+        {
+            antecedent->take();
+            return std::invoke(function);
+        }
+        else
+        {
+            return std::invoke(function, antecedent->take());
+        }
+    };
+
+    using ContinuationResult = std::invoke_result_t<decltype(continuation)&>;
+    using Task = detail::AsyncTask<ContinuationResult, decltype(continuation)>;
+
+    auto pool = antecedent->getPool();
+    auto task = std::make_shared<Task>(pool, std::move(continuation));
+    Future<ContinuationResult> future(task);
+    antecedent->setContinuation(std::move(task));
+    return future;
+}
+
+} // namespace stew
+
+#endif // STEW_FUTURE_HPP
@@ -22,7 +22,9 @@
 #include <stew/stew_api.hpp>
 #include <stew/tasks/thread_pool.hpp>
 
+#include <functional>
 #include <memory>
+#include <string_view>
 
 namespace stew
 {
@@ -66,17 +68,12 @@ using JobPtr = std::shared_ptr<Job>;
 ///     {
 ///         // Try to push the job into the buffer. If the push fails, try to schedule the job,
 ///         // so that it can process the buffer.
-///         auto scheduled = false;
 ///         while (!m_buffer.tryPush(text))
 ///         {
-///             scheduled != async(shared_from_this());
-///         }
-///         // If it was a successful push, or there was a successful push after an unsuccessful one,
-///         // schedule itself for processing.
-///         if (!scheduled)
-///         {
 ///             async(shared_from_this());
 ///         }
+///         // Schedule itself for processing. If the job is already queued, the call does nothing.
+///         async(shared_from_this());
 ///     }
 ///
 /// protected:
@@ -180,6 +177,10 @@ public:
         Stopped
     };
 
+    /// The completion handler of a job. The handler receives the status the job settled with, which
+    /// is either Status::Completed or Status::Stopped.
+    using CompletionHandler = std::function<void(Status)>;
+
     /// Destructor.
     virtual ~Job();
 
@@ -197,9 +198,39 @@ public:
     /// Returns whether the job is queued or running.
     bool isBusy() const;
 
-    /// Waits for the job to complete.
+    /// Returns the priority of the job.
+    /// \return The priority of the job.
+    JobPriority getPriority() const override;
+
+    /// Sets the priority of the job. The priority takes effect the next time the job gets queued.
+    /// \param priority The priority to set.
+    void setPriority(JobPriority priority);
+
+    /// Returns the deadline of the job.
+    /// \return The deadline of the job, or ThreadPool::Clock::time_point::max() if the job has no
+    /// deadline.
+    ThreadPool::Clock::time_point getDeadline() const override;
+
+    /// Sets the deadline of the job. The thread pool serves the jobs with a deadline before the other
+    /// jobs, in earliest deadline first order. The deadline takes effect the next time the job gets
+    /// queued. Pass ThreadPool::Clock::time_point::max() to clear the deadline.
+    /// \param deadline The deadline to set.
+    void setDeadline(ThreadPool::Clock::time_point deadline);
+
+    /// Waits for the job to complete. If the job reschedules itself on completion, the method waits
+    /// till the job gets deferred or stopped. When called from a thread of a pool, the thread runs the
+    /// queued jobs of its pool while it waits.
     void wait();
 
+    /// Adds a completion handler to a busy job. The handler is called once, when the job settles:
+    /// after the job completes and gets deferred, or when the job gets stopped. A job which reschedules
+    /// itself on completion calls the handler when the rescheduled runs complete. The handler is called
+    /// on the thread which settles the job.
+    /// \param handler The handler to add.
+    /// \return If the job is busy, and the handler got added, returns \e true. If the job is deferred
+    ///         or stopped, returns \e false, and the handler is not added.
+    bool addCompletionHandler(CompletionHandler handler);
+
     /// Overloads enable_shared_from_this
     JobPtr shared_from_this()
     {
@@ -210,8 +241,9 @@ protected:
     explicit Job();
 
     /// Implement BaseJob interface.
-    bool canQueue() const override;
-    void queue() final;
+    bool tryQueue() final;
+    bool canQueue() const final;
+    void cancel() final;
     void schedule() final;
     void complete() final;
 
@@ -242,6 +274,21 @@ private:
 /// \return If the job got scheduled with success, returns \e true, otherwise \e false.
 bool STEW_API async(JobPtr job);
 
+/// Executes the job asynchronously on a thread pool. If the thread pool is null, the job is executed
+/// on the calling thread.
+/// \param pool The thread pool which executes the job.
+/// \param job The job to execute.
+/// \return If the job got scheduled with success, returns \e true, otherwise \e false.
+bool STEW_API async(ThreadPool* pool, JobPtr job);
+
+/// Executes the job asynchronously on a named executor of the library. If the library has no thread
+/// pool, the job is executed on the calling thread.
+/// \param executor The name of the executor.
+/// \param job The job to execute.
+/// \return If the job got scheduled with success, returns \e true. If the library has no executor with
+///         the name, or the executor fails to schedule the job, returns \e false.
+bool STEW_API async(std::string_view executor, JobPtr job);
+
 }
 
 #endif // STEW_JOB_HPP
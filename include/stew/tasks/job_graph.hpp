@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_JOB_GRAPH_HPP
+#define STEW_JOB_GRAPH_HPP
+
+#include <stew/stew_api.hpp>
+#include <stew/tasks/job.hpp>
+
+#include <memory>
+
+namespace stew
+{
+
+/// A job graph executes a set of jobs in the order of their dependencies. Each job of the graph is
+/// scheduled on the thread pool as soon as the jobs it depends on complete. The graph counts the
+/// pending predecessors of each job atomically, so the scheduling of a job does not lock the graph.
+///
+/// The dependencies of the graph must form a directed acyclic graph. A graph with a cycle does not
+/// start.
+///
+/// When a job of the graph gets stopped, the graph stops the rest of its jobs. The jobs which did not
+/// get scheduled are stopped without running. You can stop the graph by calling stop().
+/// \code
+/// JobGraph graph;
+/// graph.addDependency(load, parse);
+/// graph.addDependency(parse, validate);
+/// graph.addDependency(parse, index);
+/// graph.start();
+/// graph.wait();
+/// \endcode
+class STEW_API JobGraph
+{
+public:
+    /// Constructs a job graph, which runs its jobs on a thread pool.
+    /// \param pool The thread pool to run the jobs. If \e nullptr, the graph runs the jobs on the thread
+    ///        pool of the library. If the library has no thread pool, the jobs run on the thread which
+    ///        schedules them.
+    explicit JobGraph(ThreadPool* pool = nullptr);
+    /// Destructor. Stops the graph, and waits for its jobs to settle.
+    ~JobGraph();
+
+    /// Adds a job to the graph. A job added to the graph more than once is added only once. You can
+    /// add jobs only when the graph is not running.
+    /// \param job The job to add.
+    void addJob(JobPtr job);
+
+    /// Adds a dependency between two jobs of the graph. The jobs are added to the graph if they are not
+    /// yet added. You can add dependencies only when the graph is not running.
+    /// \param predecessor The job to complete before the successor runs.
+    /// \param successor The job which runs after the predecessor completes.
+    void addDependency(JobPtr predecessor, JobPtr successor);
+
+    /// Returns the number of jobs in the graph.
+    std::size_t getJobCount() const;
+
+    /// Starts the graph. Schedules the jobs with no predecessors.
+    /// \return If the graph started, returns \e true. If the graph is already running, or the
+    ///         dependencies of the graph have a cycle, returns \e false.
+    bool start();
+
+    /// Stops the graph. Stops the running jobs of the graph, and the jobs which are not yet scheduled.
+    void stop();
+
+    /// Waits till all the jobs of the graph complete or get stopped. A thread of a pool runs the queued
+    /// jobs of its pool meanwhile.
+    void wait();
+
+    /// Returns whether the graph is running.
+    bool isRunning() const;
+
+    /// Returns whether the last run of the graph got stopped.
+    bool isStopped() const;
+
+private:
+    DISABLE_COPY(JobGraph);
+    DISABLE_MOVE(JobGraph);
+
+    struct Descriptor;
+    // The completion handlers of the jobs share the descriptor with the graph.
+    std::shared_ptr<Descriptor> descriptor;
+};
+
+} // namespace stew
+
+#endif // STEW_JOB_GRAPH_HPP
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_JOB_GROUP_HPP
+#define STEW_JOB_GROUP_HPP
+
+#include <stew/stew_api.hpp>
+#include <stew/tasks/job.hpp>
+#include <stew/tasks/thread_pool.hpp>
+
+#include <chrono>
+#include <memory>
+
+namespace stew
+{
+
+/// A job group schedules a set of jobs, and waits for them or cancels them together. The group
+/// counts its pending jobs atomically, and tracks only its own jobs, so waiting for or cancelling a
+/// group does not depend on the other jobs of the thread pool.
+///
+/// The jobs leave the group when they settle. You can add jobs to a group while other jobs of the
+/// group run.
+/// \code
+/// JobGroup group;
+/// for (auto& request : requests)
+/// {
+///     group.addJob(std::make_shared<RequestJob>(request));
+/// }
+/// group.waitAll();
+/// \endcode
+class STEW_API JobGroup
+{
+public:
+    /// The aggregate timing of the jobs of a group.
+    struct Timing
+    {
+        /// The number of jobs which completed.
+        std::size_t completedCount = 0u;
+        /// The number of jobs which got stopped.
+        std::size_t stoppedCount = 0u;
+        /// The sum of the latencies of the settled jobs. The latency of a job is the time between its
+        /// addition to the group and its settlement.
+        std::chrono::nanoseconds totalLatency = std::chrono::nanoseconds::zero();
+        /// The longest latency of the settled jobs.
+        std::chrono::nanoseconds maxLatency = std::chrono::nanoseconds::zero();
+        /// The time the group had pending jobs.
+        std::chrono::nanoseconds busyTime = std::chrono::nanoseconds::zero();
+    };
+
+    /// Constructs a job group, which runs its jobs on a thread pool.
+    /// \param pool The thread pool to run the jobs. If \e nullptr, the group runs the jobs on the thread
+    ///        pool of the library. If the library has no thread pool, the jobs run on the thread which
+    ///        adds them.
+    explicit JobGroup(ThreadPool* pool = nullptr);
+    /// Destructor. Cancels the pending jobs of the group, and waits for them to settle.
+    ~JobGroup();
+
+    /// Adds a job to the group, and schedules the job.
+    /// \param job The job to add.
+    /// \return If the job got scheduled, returns \e true. If the job is already a pending job of the
+    ///         group, or the thread pool rejects the job, returns \e false, and the job does not join
+    ///         the group.
+    bool addJob(JobPtr job);
+
+    /// Returns the number of jobs of the group which did not yet settle.
+    /// \return The number of pending jobs.
+    std::size_t getPendingCount() const;
+
+    /// Waits till all the jobs of the group settle. A thread of a pool runs the queued jobs of its pool
+    /// meanwhile.
+    void waitAll();
+
+    /// Stops the pending jobs of the group. The jobs which are queued get stopped without running.
+    void cancelAll();
+
+    /// Returns the aggregate timing of the jobs of the group.
+    /// \return The timing of the group.
+    Timing getTiming() const;
+
+private:
+    DISABLE_COPY(JobGroup);
+    DISABLE_MOVE(JobGroup);
+
+    struct Descriptor;
+    // The completion handlers of the jobs share the descriptor with the group.
+    std::shared_ptr<Descriptor> descriptor;
+};
+
+} // namespace stew
+
+#endif // STEW_JOB_GROUP_HPP
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_PARALLEL_HPP
+#define STEW_PARALLEL_HPP
+
+#include <stew/stew.hpp>
+#include <stew/tasks/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <variant>
+
+namespace stew
+{
+
+namespace detail
+{
+
+/// A part of a parallel algorithm forked to the thread pool. The task runs either on a thread of the
+/// pool, or on the thread which joins it, whichever claims the task first. This way the joining thread
+/// never waits for a task which is still queued.
+template <typename Result>
+class STEW_TEMPLATE_API ForkedTaskBase : public ThreadPool::BaseJob
+{
+    using ValueType = std::conditional_t<std::is_void_v<Result>, std::monostate, Result>;
+
+public:
+    /// Joins the task. If the task is not yet claimed, runs it on the calling thread, otherwise waits
+    /// till the task completes. A thread of a pool runs the queued jobs of its pool while it waits.
+    /// If the task failed, rethrows the exception of the task.
+    Result join()
+    {
+        if (tryClaim())
+        {
+            run();
+        }
+        else if (auto pool = ThreadPool::getCurrent())
+        {
+            pool->waitUntil([this]() { return m_done.load(); });
+        }
+        else
+        {
+            while (!m_done)
+            {
+                m_done.wait(false);
+            }
+        }
+
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+        if constexpr (!std::is_void_v<Result>)
+        {
+            return std::move(*m_result);
+        }
+    }
+
+    /// Joins the task, and drops its result and its exception. Use this to join the task while an
+    /// other exception unwinds the stack.
+    void joinQuietly()
+    {
+        try
+        {
+            join();
+        }
+        catch (...)
+        {
+        }
+    }
+
+protected:
+    /// Executes the task.
+    virtual Result execute() = 0;
+
+    bool tryQueue() override
+    {
+        return true;
+    }
+    void schedule() override
+    {
+        if (tryClaim())
+        {
+            run();
+        }
+    }
+    void complete() override
+    {
+    }
+    /// The joining thread runs the cancelled task.
+    void cancel() override
+    {
+    }
+
+private:
+    bool tryClaim()
+    {
+        return !m_claimed.exchange(true);
+    }
+
+    void run()
+    {
+        try
+        {
+            if constexpr (std::is_void_v<Result>)
+            {
+                execute();
+            }
+            else
+            {
+                m_result.emplace(execute());
+            }
+        }
+        catch (...)
+        {
+            m_error = std::current_exception();
+        }
+        m_done = true;
+        m_done.notify_all();
+        ThreadPool::notifyWaiters();
+    }
+
+    std::optional<ValueType> m_result;
+    std::exception_ptr m_error;
+    std::atomic_bool m_claimed = false;
+    std::atomic_bool m_done = false;
+};
+
+template <typename Result, typename Function>
+class STEW_TEMPLATE_API ForkedTask : public ForkedTaskBase<Result>
+{
+    Function m_function;
+
+public:
+    explicit ForkedTask(Function function) :
+        m_function(std::move(function))
+    {
+    }
+
+protected:
+    Result execute() override
+    {
+        return m_function();
+    }
+};
+
+/// Forks a function to the thread pool. Join the returned task to get the result of the function. The
+/// task is allocated from the task slots of the pool, so a split costs no heap allocation once the pool
+/// has warmed up.
+template <typename Function>
+auto fork(ThreadPool* pool, Function function)
+{
+    using Task = ForkedTask<std::invoke_result_t<Function&>, Function>;
+    if (!pool)
+    {
+        // Without a pool, the join runs the task.
+        return std::make_shared<Task>(std::move(function));
+    }
+    auto task = std::allocate_shared<Task>(TaskSlotAllocator<Task>(*pool), std::move(function));
+    // When the pool rejects the task, the join runs it.
+    pool->tryScheduleTask(task);
+    return task;
+}
+
+/// Returns the grain size of a range. Unless given, splits the range to a few chunks per thread, so
+/// that the threads can balance the load.
+inline std::size_t getGrainSize(ThreadPool* pool, std::size_t size, std::size_t grainSize, std::size_t minimumGrainSize = 1u)
+{
+    if (grainSize > 0u)
+    {
+        return grainSize;
+    }
+    if (!pool)
+    {
+        return std::max<std::size_t>(size, 1u);
+    }
+    return std::max(size / (4u * (pool->getThreadCount() + 1u)), minimumGrainSize);
+}
+
+template <typename Position>
+std::size_t getDistance(Position first, Position last)
+{
+    return (last > first) ? static_cast<std::size_t>(last - first) : 0u;
+}
+
+/// Splits a range recursively till the chunks get smaller than the grain size. Forks the upper half
+/// of the range, and processes the lower half on the calling thread.
+template <typename Position, typename Function>
+void forRange(ThreadPool* pool, Position first, Position last, std::size_t grainSize, Function& function)
+{
+    const auto size = getDistance(first, last);
+    if (size <= grainSize)
+    {
+        for (auto count = size; count > 0u; --count, ++first)
+        {
+            function(first);
+        }
+        return;
+    }
+
+    const Position middle = first + static_cast<std::ptrdiff_t>(size / 2u);
+    auto forked = fork(pool, [pool, middle, last, grainSize, &function]()
+    {
+        forRange(pool, middle, last, grainSize, function);
+    });
+    try
+    {
+        forRange(pool, first, middle, grainSize, function);
+    }
+    catch (...)
+    {
+        forked->joinQuietly();
+        throw;
+    }
+    forked->join();
+}
+
+/// Reduces a non-empty range.
+template <typename Value, typename Iterator, typename Operation>
+Value reduceRange(ThreadPool* pool, Iterator first, Iterator last, std::size_t grainSize, Operation& operation)
+{
+    const auto size = getDistance(first, last);
+    if (size <= grainSize)
+    {
+        Value value = *first;
+        for (++first; first != last; ++first)
+        {
+            value = operation(std::move(value), *first);
+        }
+        return value;
+    }
+
+    const auto middle = first + static_cast<std::ptrdiff_t>(size / 2u);
+    auto forked = fork(pool, [pool, middle, last, grainSize, &operation]()
+    {
+        return reduceRange<Value>(pool, middle, last, grainSize, operation);
+    });
+    auto lower = [&]()
+    {
+        try
+        {
+            return reduceRange<Value>(pool, first, middle, grainSize, operation);
+        }
+        catch (...)
+        {
+            forked->joinQuietly();
+            throw;
+        }
+    }();
+    return operation(std::move(lower), forked->join());
+}
+
+/// Sorts a range. Partitions the range around its median, then sorts the two partitions in parallel.
+template <typename Iterator, typename Compare>
+void sortRange(ThreadPool* pool, Iterator first, Iterator last, std::size_t grainSize, Compare& compare)
+{
+    const auto size = getDistance(first, last);
+    if (size <= grainSize)
+    {
+        std::sort(first, last, compare);
+        return;
+    }
+
+    const auto middle = first + static_cast<std::ptrdiff_t>(size / 2u);
+    std::nth_element(first, middle, last, compare);
+    auto forked = fork(pool, [pool, middle, last, grainSize, &compare]()
+    {
+        sortRange(pool, middle, last, grainSize, compare);
+    });
+    try
+    {
+        sortRange(pool, first, middle, grainSize, compare);
+    }
+    catch (...)
+    {
+        forked->joinQuietly();
+        throw;
+    }
+    forked->join();
+}
+
+} // namespace detail
+
+/// Calls a function for each index of a range, in parallel, on the thread pool of the library. The
+/// range is split recursively into chunks, and the calling thread processes chunks too. If the library
+/// has no thread pool, the function is called on the calling thread. If the function throws, the
+/// first exception caught is rethrown after the running chunks complete.
+/// \tparam Index The integral type of the indexes.
+/// \tparam Function The function type, called with an index.
+/// \param first The first index of the range.
+/// \param last The index after the last index of the range.
+/// \param function The function to call.
+/// \param grainSize The size of the chunks which are not split further. If 0, the grain size is
+///        calculated from the size of the range and the number of threads of the thread pool.
+template <typename Index, typename Function>
+    requires std::integral<Index> && std::invocable<Function&, Index>
+void parallelFor(Index first, Index last, Function function, std::size_t grainSize = 0u)
+{
+    auto pool = Library::instance().threadPool();
+    grainSize = detail::getGrainSize(pool, detail::getDistance(first, last), grainSize);
+    detail::forRange(pool, first, last, grainSize, function);
+}
+
+/// Calls a function for each element of a range, in parallel, on the thread pool of the library.
+/// \tparam Iterator The random access iterator type of the range.
+/// \tparam Function The function type, called with an element of the range.
+/// \param first The iterator to the first element of the range.
+/// \param last The iterator after the last element of the range.
+/// \param function The function to call.
+/// \param grainSize The size of the chunks which are not split further. If 0, the grain size is
+///        calculated from the size of the range and the number of threads of the thread pool.
+/// \see parallelFor(Index, Index, Function, std::size_t)
+template <typename Iterator, typename Function>
+    requires std::random_access_iterator<Iterator> && std::invocable<Function&, std::iter_reference_t<Iterator>>
+void parallelFor(Iterator first, Iterator last, Function function, std::size_t grainSize = 0u)
+{
+    auto pool = Library::instance().threadPool();
+    grainSize = detail::getGrainSize(pool, detail::getDistance(first, last), grainSize);
+    auto invoker = [&function](Iterator position)
+    {
+        function(*position);
+    };
+    detail::forRange(pool, first, last, grainSize, invoker);
+}
+
+/// Reduces a range in parallel, on the thread pool of the library. The chunks of the range are
+/// reduced in an unspecified order, so the operation must be associative and commutative.
+/// \tparam Iterator The random access iterator type of the range.
+/// \tparam Value The type of the reduced value.
+/// \tparam Operation The binary operation type.
+/// \param first The iterator to the first element of the range.
+/// \param last The iterator after the last element of the range.
+/// \param init The initial value of the reduction.
+/// \param operation The binary operation which combines two values.
+/// \param grainSize The size of the chunks which are not split further. If 0, the grain size is
+///        calculated from the size of the range and the number of threads of the thread pool.
+/// \return The reduced value.
+template <typename Iterator, typename Value, typename Operation = std::plus<>>
+    requires std::random_access_iterator<Iterator>
+Value parallelReduce(Iterator first, Iterator last, Value init, Operation operation = {}, std::size_t grainSize = 0u)
+{
+    const auto size = detail::getDistance(first, last);
+    if (size == 0u)
+    {
+        return init;
+    }
+    auto pool = Library::instance().threadPool();
+    grainSize = detail::getGrainSize(pool, size, grainSize);
+    return operation(std::move(init), detail::reduceRange<Value>(pool, first, last, grainSize, operation));
+}
+
+/// Sorts a range in parallel, on the thread pool of the library. The sort is not stable.
+/// \tparam Iterator The random access iterator type of the range.
+/// \tparam Compare The comparison function type.
+/// \param first The iterator to the first element of the range.
+/// \param last The iterator after the last element of the range.
+/// \param compare The comparison function.
+/// \param grainSize The size of the chunks which are sorted on a single thread. If 0, the grain size
+///        is calculated from the size of the range and the number of threads of the thread pool.
+template <typename Iterator, typename Compare = std::less<>>
+    requires std::random_access_iterator<Iterator>
+void parallelSort(Iterator first, Iterator last, Compare compare = {}, std::size_t grainSize = 0u)
+{
+    // Sorting short chunks in parallel costs more than it gains.
+    constexpr auto minimumGrainSize = std::size_t(1024u);
+
+    auto pool = Library::instance().threadPool();
+    grainSize = detail::getGrainSize(pool, detail::getDistance(first, last), grainSize, minimumGrainSize);
+    detail::sortRange(pool, first, last, grainSize, compare);
+}
+
+} // namespace stew
+
+#endif // STEW_PARALLEL_HPP
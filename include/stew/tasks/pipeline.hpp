@@ -0,0 +1,629 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_PIPELINE_HPP
+#define STEW_PIPELINE_HPP
+
+#include <stew/stew.hpp>
+#include <stew/stew_api.hpp>
+#include <stew/tasks/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace stew
+{
+
+/// A stage of a pipeline. The stage owns the bounded channel of its input items. The stage is
+/// scheduled on its thread pool only when its channel holds items, and the channel of the next stage
+/// has room for its output. When the channel of the next stage is full, the stage stalls, and resumes
+/// when the next stage frees room, so a slow stage applies backpressure on the stages before it.
+///
+/// A stage runs on at most one thread of the pool at a time, and processes a batch of items per
+/// activation, so the items leave the stage in the order they arrived. A bounded thread pool queues the
+/// activations of the stages beyond its capacity, as the channels bound the items of the pipeline.
+class STEW_API PipelineStage : public ThreadPool::BaseJob
+{
+public:
+    /// The metrics of a stage.
+    struct STEW_API Metrics
+    {
+        /// The number of items the stage processed.
+        std::size_t processedCount = 0u;
+        /// The number of items waiting in the input channel of the stage.
+        std::size_t queueDepth = 0u;
+        /// The highest number of items the input channel held.
+        std::size_t maxQueueDepth = 0u;
+        /// The capacity of the input channel.
+        std::size_t capacity = 0u;
+        /// The number of times the stage stalled on the full channel of the next stage.
+        std::size_t stallCount = 0u;
+        /// The time the stage spent processing items.
+        std::chrono::nanoseconds busyTime = std::chrono::nanoseconds::zero();
+        /// The time elapsed since the stage got created.
+        std::chrono::nanoseconds elapsed = std::chrono::nanoseconds::zero();
+
+        /// Returns the throughput of the stage.
+        /// \return The number of items processed per second since the stage got created.
+        double getThroughput() const;
+    };
+
+    /// Destructor.
+    ~PipelineStage() override;
+
+    /// Returns the metrics of the stage.
+    /// \return The metrics of the stage.
+    Metrics getMetrics() const;
+
+    /// Activates the stage, if it has work and it is not scheduled yet. The channels call it when an
+    /// item arrives, and when the channel of the next stage frees room.
+    void notify();
+
+protected:
+    /// The outcome of processing the next item of a stage.
+    enum class Progress
+    {
+        /// The stage processed an item.
+        Processed,
+        /// The input channel of the stage is empty.
+        Empty,
+        /// The channel of the next stage is full.
+        Stalled
+    };
+
+    /// Constructs a stage.
+    /// \param pool The thread pool of the stage. If \e nullptr, the stage runs on the thread pool of
+    ///        the library. If the library has no thread pool, the stage runs on the thread which
+    ///        pushes its items.
+    /// \param batchSize The maximum number of items the stage processes per activation.
+    explicit PipelineStage(ThreadPool* pool, std::size_t batchSize);
+
+    /// Processes the next item of the input channel.
+    /// \return The outcome of processing.
+    virtual Progress processNext() = 0;
+    /// Returns whether the stage has an item to process, and room for its output.
+    virtual bool hasWork() const = 0;
+    /// Drops the items of the input channel, when the stage gets cancelled.
+    virtual void dropItems() = 0;
+    /// Fills the channel metrics of the stage.
+    virtual void getChannelMetrics(Metrics& metrics) const = 0;
+
+    /// Implement BaseJob interface.
+    bool tryQueue() override;
+    void schedule() override;
+    void complete() override;
+    void cancel() override;
+    bool isContinuation() const override;
+
+private:
+    struct Descriptor;
+    std::unique_ptr<Descriptor> descriptor;
+};
+using PipelineStagePtr = std::shared_ptr<PipelineStage>;
+
+namespace detail
+{
+
+/// The state shared by the stages of a pipeline.
+struct PipelineState
+{
+    /// The number of items pushed to the pipeline, and not yet consumed by its sink.
+    std::atomic_size_t pendingCount = 0u;
+    /// Whether the pipeline accepts items.
+    std::atomic_bool isClosed = false;
+
+    /// Releases items which left the pipeline, and wakes the waiters when the pipeline runs empty.
+    void release(std::size_t count)
+    {
+        if (count > 0u && (pendingCount -= count) == 0u)
+        {
+            pendingCount.notify_all();
+            ThreadPool::notifyWaiters();
+        }
+    }
+};
+
+/// A stage with a bounded input channel of Input items.
+template <typename Input>
+class PipelineChannelStage : public PipelineStage
+{
+public:
+    explicit PipelineChannelStage(ThreadPool* pool, std::size_t batchSize, std::size_t capacity, std::shared_ptr<PipelineState> state) :
+        PipelineStage(pool, batchSize),
+        m_state(std::move(state)),
+        m_capacity(capacity)
+    {
+    }
+
+    /// Pushes an item to the channel, and activates the stage. Fails if the channel is full, in which
+    /// case the item is left untouched.
+    bool tryPush(Input&& item)
+    {
+        {
+            GuardLock lock(m_lock);
+            if (m_items.size() >= m_capacity)
+            {
+                return false;
+            }
+            pushLocked(std::move(item));
+        }
+        notify();
+        return true;
+    }
+
+    /// Waits for room in the channel, then pushes the item. Fails if the pipeline gets closed meanwhile.
+    bool waitAndPush(Input&& item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_spaceCondition.wait(lock, [this]() { return m_items.size() < m_capacity || m_state->isClosed; });
+            if (m_state->isClosed)
+            {
+                return false;
+            }
+            pushLocked(std::move(item));
+        }
+        notify();
+        return true;
+    }
+
+    /// Returns whether the channel is full.
+    bool isFull() const
+    {
+        GuardLock lock(m_lock);
+        return m_items.size() >= m_capacity;
+    }
+
+    /// Wakes the producers which wait for room.
+    void wakeProducers()
+    {
+        {
+            GuardLock lock(m_lock);
+        }
+        m_spaceCondition.notify_all();
+    }
+
+    /// Sets the stage which feeds the channel.
+    void setUpstream(std::weak_ptr<PipelineStage> upstream)
+    {
+        m_upstream = std::move(upstream);
+    }
+
+protected:
+    /// Pops the next item of the channel. When the pop frees room in a full channel, activates the
+    /// stage before, and wakes the waiting producers.
+    std::optional<Input> tryPop()
+    {
+        std::optional<Input> item;
+        bool wasFull = false;
+        {
+            GuardLock lock(m_lock);
+            if (m_items.empty())
+            {
+                return item;
+            }
+            wasFull = m_items.size() >= m_capacity;
+            item.emplace(std::move(m_items.front()));
+            m_items.pop_front();
+        }
+        if (wasFull)
+        {
+            roomFreed();
+        }
+        return item;
+    }
+
+    bool hasItems() const
+    {
+        GuardLock lock(m_lock);
+        return !m_items.empty();
+    }
+
+    void dropItems() override
+    {
+        std::size_t count = 0u;
+        {
+            GuardLock lock(m_lock);
+            count = m_items.size();
+            m_items.clear();
+        }
+        m_state->release(count);
+        if (count > 0u)
+        {
+            roomFreed();
+        }
+    }
+
+    void getChannelMetrics(Metrics& metrics) const override
+    {
+        GuardLock lock(m_lock);
+        metrics.queueDepth = m_items.size();
+        metrics.maxQueueDepth = m_maxDepth;
+        metrics.capacity = m_capacity;
+    }
+
+    std::shared_ptr<PipelineState> m_state;
+
+private:
+    void pushLocked(Input&& item)
+    {
+        m_items.push_back(std::move(item));
+        m_maxDepth = std::max(m_maxDepth, m_items.size());
+    }
+
+    void roomFreed()
+    {
+        if (auto upstream = m_upstream.lock())
+        {
+            upstream->notify();
+        }
+        m_spaceCondition.notify_all();
+        ThreadPool::notifyWaiters();
+    }
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_spaceCondition;
+    std::deque<Input> m_items;
+    std::weak_ptr<PipelineStage> m_upstream;
+    const std::size_t m_capacity = 0u;
+    std::size_t m_maxDepth = 0u;
+};
+
+/// The output end of a stage, which gets connected to the next stage.
+template <typename Output>
+class PipelineOutlet
+{
+public:
+    virtual ~PipelineOutlet() = default;
+    virtual void connect(std::shared_ptr<PipelineChannelStage<Output>> next) = 0;
+};
+
+/// A stage which transforms its input items, and passes the results to the next stage.
+template <typename Input, typename Output, typename Function>
+class PipelineTransformStage : public PipelineChannelStage<Input>, public PipelineOutlet<Output>
+{
+    using Base = PipelineChannelStage<Input>;
+
+public:
+    explicit PipelineTransformStage(ThreadPool* pool, std::size_t batchSize, std::size_t capacity, std::shared_ptr<PipelineState> state, Function function) :
+        Base(pool, batchSize, capacity, std::move(state)),
+        m_function(std::move(function))
+    {
+    }
+
+    void connect(std::shared_ptr<PipelineChannelStage<Output>> next) override
+    {
+        next->setUpstream(std::static_pointer_cast<PipelineStage>(this->shared_from_this()));
+        m_next = std::move(next);
+    }
+
+protected:
+    typename Base::Progress processNext() override
+    {
+        // The stage is the only producer of the next channel, so the room stays till the push.
+        if (m_next->isFull())
+        {
+            return Base::Progress::Stalled;
+        }
+        auto item = this->tryPop();
+        if (!item)
+        {
+            return Base::Progress::Empty;
+        }
+        m_next->tryPush(std::invoke(m_function, std::move(*item)));
+        return Base::Progress::Processed;
+    }
+
+    bool hasWork() const override
+    {
+        return this->hasItems() && !m_next->isFull();
+    }
+
+private:
+    Function m_function;
+    std::shared_ptr<PipelineChannelStage<Output>> m_next;
+};
+
+/// The last stage of a pipeline, which consumes its input items.
+template <typename Input, typename Function>
+class PipelineSinkStage : public PipelineChannelStage<Input>
+{
+    using Base = PipelineChannelStage<Input>;
+
+public:
+    explicit PipelineSinkStage(ThreadPool* pool, std::size_t batchSize, std::size_t capacity, std::shared_ptr<PipelineState> state, Function function) :
+        Base(pool, batchSize, capacity, std::move(state)),
+        m_function(std::move(function))
+    {
+    }
+
+protected:
+    typename Base::Progress processNext() override
+    {
+        auto item = this->tryPop();
+        if (!item)
+        {
+            return Base::Progress::Empty;
+        }
+        std::invoke(m_function, std::move(*item));
+        this->m_state->release(1u);
+        return Base::Progress::Processed;
+    }
+
+    bool hasWork() const override
+    {
+        return this->hasItems();
+    }
+
+private:
+    Function m_function;
+};
+
+} // namespace detail
+
+template <typename Input, typename Output>
+class PipelineBuilder;
+
+/// A pipeline of stages, connected by bounded channels. Push the items to the pipeline with tryPush()
+/// or push(). The items flow through the stages of the pipeline, each stage running on the thread
+/// pool only while it has items to process. Build a pipeline with a PipelineBuilder.
+/// \code
+/// auto pipeline = stew::PipelineBuilder<std::string>(threadPool)
+///     .then([](std::string line) { return parse(line); })
+///     .sink([](Record record) { store(record); });
+/// pipeline.push(readLine());
+/// \endcode
+/// \tparam Input The type of the items pushed to the pipeline.
+template <typename Input>
+class STEW_TEMPLATE_API Pipeline
+{
+public:
+    /// Tries to push an item to the pipeline.
+    /// \param item The item to push.
+    /// \return If the item got pushed, returns \e true. If the channel of the first stage is full, or
+    ///         the pipeline is closed, returns \e false.
+    bool tryPush(Input item)
+    {
+        if (m_state->isClosed)
+        {
+            return false;
+        }
+        ++m_state->pendingCount;
+        if (!m_entry->tryPush(std::move(item)))
+        {
+            m_state->release(1u);
+            return false;
+        }
+        return true;
+    }
+
+    /// Pushes an item to the pipeline. If the channel of the first stage is full, waits till the
+    /// channel gets room. A thread of a pool runs the queued jobs of its pool meanwhile, and parks
+    /// while its pool has no queued jobs.
+    /// \param item The item to push.
+    /// \return If the item got pushed, returns \e true. If the pipeline is closed, returns \e false.
+    bool push(Input item)
+    {
+        if (m_state->isClosed)
+        {
+            return false;
+        }
+        ++m_state->pendingCount;
+        auto pushed = false;
+        if (auto pool = ThreadPool::getCurrent())
+        {
+            while (!(pushed = m_entry->tryPush(std::move(item))) && !m_state->isClosed)
+            {
+                pool->waitUntil([this]() { return !m_entry->isFull() || m_state->isClosed; });
+            }
+        }
+        else
+        {
+            pushed = m_entry->waitAndPush(std::move(item));
+        }
+        if (!pushed)
+        {
+            m_state->release(1u);
+        }
+        return pushed;
+    }
+
+    /// Closes the pipeline. A closed pipeline rejects the items pushed, and the producers waiting
+    /// for room give up. The items already pushed flow through the stages.
+    void close()
+    {
+        m_state->isClosed = true;
+        m_entry->wakeProducers();
+        ThreadPool::notifyWaiters();
+    }
+
+    /// Returns whether the pipeline is closed.
+    /// \return If the pipeline is closed, returns \e true, otherwise \e false.
+    bool isClosed() const
+    {
+        return m_state->isClosed;
+    }
+
+    /// Returns the number of items pushed to the pipeline, which the sink did not yet consume.
+    /// \return The number of pending items.
+    std::size_t getPendingCount() const
+    {
+        return m_state->pendingCount;
+    }
+
+    /// Waits till the sink consumes all the items pushed to the pipeline. A thread of a pool runs
+    /// the queued jobs of its pool meanwhile.
+    void wait() const
+    {
+        if (auto pool = ThreadPool::getCurrent())
+        {
+            pool->waitUntil([this]() { return m_state->pendingCount == 0u; });
+            return;
+        }
+        for (auto count = m_state->pendingCount.load(); count > 0u; count = m_state->pendingCount.load())
+        {
+            m_state->pendingCount.wait(count);
+        }
+    }
+
+    /// Returns the stages of the pipeline, in the order of the item flow.
+    /// \return The stages of the pipeline.
+    const std::vector<PipelineStagePtr>& getStages() const
+    {
+        return m_stages;
+    }
+
+    /// Returns the metrics of the stages of the pipeline, in the order of the item flow.
+    /// \return The metrics of the stages.
+    std::vector<PipelineStage::Metrics> getMetrics() const
+    {
+        std::vector<PipelineStage::Metrics> metrics;
+        metrics.reserve(m_stages.size());
+        for (auto& stage : m_stages)
+        {
+            metrics.push_back(stage->getMetrics());
+        }
+        return metrics;
+    }
+
+private:
+    template <typename, typename>
+    friend class PipelineBuilder;
+
+    std::shared_ptr<detail::PipelineState> m_state;
+    std::shared_ptr<detail::PipelineChannelStage<Input>> m_entry;
+    std::vector<PipelineStagePtr> m_stages;
+};
+
+/// Builds a pipeline stage by stage. Each then() call appends a stage which transforms the items,
+/// and sink() appends the last stage, which consumes the items, and returns the pipeline. The
+/// functions of the stages must not throw.
+/// \tparam Input The type of the items pushed to the pipeline.
+/// \tparam Output The type of the items the stages built so far produce.
+template <typename Input, typename Output = Input>
+class STEW_TEMPLATE_API PipelineBuilder
+{
+public:
+    /// The default capacity of the channels.
+    static constexpr std::size_t DefaultCapacity = 64u;
+
+    /// Constructs a pipeline builder.
+    /// \param pool The thread pool of the stages. If \e nullptr, the stages run on the thread pool of
+    ///        the library. If the library has no thread pool, the stages run on the thread which
+    ///        pushes the items.
+    /// \param batchSize The maximum number of items a stage processes per activation.
+    explicit PipelineBuilder(ThreadPool* pool = nullptr, std::size_t batchSize = 16u)
+        requires std::same_as<Input, Output> :
+        m_pool(pool),
+        m_batchSize(std::max(batchSize, std::size_t(1u))),
+        m_state(std::make_shared<detail::PipelineState>())
+    {
+    }
+
+    /// Appends a stage which transforms the items.
+    /// \tparam Function The function type of the stage, which gets an item, and returns the item to
+    ///         pass to the next stage.
+    /// \param function The function of the stage.
+    /// \param capacity The capacity of the input channel of the stage.
+    /// \return The builder of the pipeline with the stage appended.
+    template <typename Function>
+        requires std::invocable<Function&, Output&&> && (!std::is_void_v<std::invoke_result_t<Function&, Output&&>>)
+    auto then(Function function, std::size_t capacity = DefaultCapacity) &&
+    {
+        using Result = std::decay_t<std::invoke_result_t<Function&, Output&&>>;
+        using Stage = detail::PipelineTransformStage<Output, Result, Function>;
+
+        auto stage = std::make_shared<Stage>(m_pool, m_batchSize, std::max(capacity, std::size_t(1u)), m_state, std::move(function));
+        append(stage);
+
+        PipelineBuilder<Input, Result> builder(*this);
+        builder.m_outlet = stage;
+        return builder;
+    }
+
+    /// Appends the last stage, which consumes the items, and returns the pipeline.
+    /// \tparam Function The function type of the stage, which gets an item.
+    /// \param function The function of the stage.
+    /// \param capacity The capacity of the input channel of the stage.
+    /// \return The pipeline built.
+    template <typename Function>
+        requires std::invocable<Function&, Output&&>
+    Pipeline<Input> sink(Function function, std::size_t capacity = DefaultCapacity) &&
+    {
+        using Stage = detail::PipelineSinkStage<Output, Function>;
+
+        auto stage = std::make_shared<Stage>(m_pool, m_batchSize, std::max(capacity, std::size_t(1u)), m_state, std::move(function));
+        append(stage);
+
+        Pipeline<Input> pipeline;
+        pipeline.m_state = std::move(m_state);
+        pipeline.m_entry = std::move(m_entry);
+        pipeline.m_stages = std::move(m_stages);
+        return pipeline;
+    }
+
+private:
+    template <typename, typename>
+    friend class PipelineBuilder;
+
+    template <typename OtherOutput>
+    explicit PipelineBuilder(PipelineBuilder<Input, OtherOutput>& other) :
+        m_pool(other.m_pool),
+        m_batchSize(other.m_batchSize),
+        m_state(std::move(other.m_state)),
+        m_entry(std::move(other.m_entry)),
+        m_stages(std::move(other.m_stages))
+    {
+    }
+
+    /// Connects a stage to the end of the stages built so far.
+    void append(std::shared_ptr<detail::PipelineChannelStage<Output>> stage)
+    {
+        if (m_outlet)
+        {
+            m_outlet->connect(stage);
+        }
+        else if constexpr (std::is_same_v<Input, Output>)
+        {
+            m_entry = stage;
+        }
+        m_stages.push_back(std::move(stage));
+    }
+
+    ThreadPool* m_pool = nullptr;
+    std::size_t m_batchSize = 0u;
+    std::shared_ptr<detail::PipelineState> m_state;
+    std::shared_ptr<detail::PipelineChannelStage<Input>> m_entry;
+    std::vector<PipelineStagePtr> m_stages;
+    std::shared_ptr<detail::PipelineOutlet<Output>> m_outlet;
+};
+
+} // namespace stew
+
+#endif // STEW_PIPELINE_HPP
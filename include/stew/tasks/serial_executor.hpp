@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STEW_SERIAL_EXECUTOR_HPP
+#define STEW_SERIAL_EXECUTOR_HPP
+
+#include <stew/stew_api.hpp>
+#include <stew/tasks/thread_pool.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace stew
+{
+
+/// The serial executor runs tasks in order, without overlapping, on a thread pool. The tasks are
+/// posted to strands. Each strand is an independent FIFO queue of tasks, which runs on at most one
+/// thread of the pool at a time. The strands of an executor run in parallel.
+///
+/// A strand is scheduled on the thread pool when a task is posted to it, and runs a batch of its
+/// queued tasks per activation. When the strand has more tasks than the batch size, it reschedules
+/// itself, so that the other jobs of the pool get their turn.
+/// \code
+/// SerialExecutor executor(threadPool);
+/// auto session = executor.createStrand();
+/// session->post([]() { connect(); });
+/// session->post([]() { sendRequest(); });
+/// \endcode
+class STEW_API SerialExecutor
+{
+public:
+    /// The task type of the strands.
+    using Task = std::function<void()>;
+
+    /// A strand of the serial executor.
+    class STEW_API Strand : public ThreadPool::BaseJob
+    {
+    public:
+        /// Destructor.
+        ~Strand() override;
+
+        /// Posts a task to the strand. The task runs after the tasks posted earlier to the strand.
+        /// The task must not throw.
+        /// \param task The task to post.
+        /// \return If the task got posted, returns \e true. If the thread pool of the strand rejects
+        ///         the strand, returns \e false, and the pending tasks of the strand are dropped. A
+        ///         bounded pool does not reject the strand for being full, as the strand holds at
+        ///         most one place in the queues of the pool.
+        bool post(Task task);
+
+        /// Returns the number of the tasks which wait to run on the strand.
+        /// \return The number of pending tasks.
+        std::size_t getPendingCount() const;
+
+        /// Returns whether the calling thread runs a task of the strand.
+        /// \return If the calling thread runs a task of the strand, returns \e true, otherwise \e false.
+        bool isCurrent() const;
+
+    protected:
+        /// Implement BaseJob interface.
+        bool tryQueue() override;
+        void schedule() override;
+        void complete() override;
+        void cancel() override;
+        bool isContinuation() const override;
+
+    private:
+        friend class SerialExecutor;
+        explicit Strand(ThreadPool* pool, std::size_t batchSize);
+
+        struct Descriptor;
+        std::unique_ptr<Descriptor> descriptor;
+    };
+    using StrandPtr = std::shared_ptr<Strand>;
+
+    /// Constructs a serial executor.
+    /// \param pool The thread pool of the strands. If \e nullptr, the strands run on the thread pool of
+    ///        the library. If the library has no thread pool, the tasks run on the thread which posts
+    ///        them.
+    /// \param batchSize The maximum number of tasks a strand runs per activation.
+    explicit SerialExecutor(ThreadPool* pool = nullptr, std::size_t batchSize = 16u);
+
+    /// Creates a strand. The strand keeps running its tasks after the executor gets destroyed.
+    /// \return The strand created.
+    StrandPtr createStrand();
+
+    /// Returns the maximum number of tasks a strand runs per activation.
+    /// \return The batch size of the strands.
+    std::size_t getBatchSize() const;
+
+private:
+    ThreadPool* m_pool = nullptr;
+    std::size_t m_batchSize = 0u;
+};
+
+} // namespace stew
+
+#endif // STEW_SERIAL_EXECUTOR_HPP
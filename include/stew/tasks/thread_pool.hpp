@@ -21,18 +21,44 @@
 
 #include <stew/stew.hpp>
 
+#include <array>
 #include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace stew
 {
 
+class BlockingScope;
 class Job;
 class ThreadPool;
 
 using JobPtr = std::shared_ptr<Job>;
+
+namespace detail
+{
+template <typename T>
+class TaskSlotAllocator;
+}
+
+/// The priority classes of the jobs.
+enum class JobPriority
+{
+    /// Latency sensitive jobs, served before the jobs of other priority classes.
+    High,
+    /// The default priority of the jobs.
+    Normal,
+    /// Bulk jobs, served when there are no jobs of higher priority to run.
+    Background
+};
+
 using GuardLock = std::lock_guard<std::mutex>;
 using UniqueLock = std::unique_lock<std::mutex>;
 
@@ -50,8 +76,50 @@ using UniqueLock = std::unique_lock<std::mutex>;
 /// threaded environment however, you must call schedule() method to run the jobs. When you call
 /// schedule() in multi-threaded environment, that will result in yielding.
 ///
+/// The thread pool can serve the jobs in two scheduling modes. In the SchedulingMode::SharedQueue mode
+/// all the jobs are queued in a single queue, shared by all the threads of the pool. In the
+/// SchedulingMode::WorkStealing mode each thread has its own job queue. Jobs scheduled from a thread of
+/// the pool go to the queue of that thread, and jobs scheduled from outside of the pool go to a shared
+/// injection queue. Threads run their own jobs first, newest first, and when their queue runs dry, they
+/// take jobs from the injection queue, or steal the oldest job from the queue of an other thread. Set
+/// the scheduling mode before you start the thread pool.
+///
+/// Jobs are served by their priority. The thread pool keeps a queue for each priority class, and
+/// serves the queue of the highest priority first. To avoid starvation, a job which waits in a lower
+/// priority queue longer than the priority aging time is served before the higher priority jobs
+/// queued after it. In work stealing mode, the normal priority jobs scheduled from a thread of the
+/// pool go to the queue of that thread.
+///
+/// The normal priority jobs without a deadline, scheduled to the shared queues, go to a bounded
+/// lock-free inbound queue, and the threads of the pool take them without locking while no other
+/// queue holds jobs. The queue lock is still taken to schedule the high priority, background and
+/// deadline jobs, to schedule a job while the inbound queue is full, to take a job while the other
+/// queues hold jobs, when an elastic pool checks the age of its queued jobs, and to park and wake the
+/// idle threads. A job scheduled on a full inbound queue is queued after the jobs of the inbound queue.
+///
+/// You can schedule a job to run after a delay, at a given time, or periodically. A timer thread of
+/// the pool queues the timed jobs when they are due. The timed jobs stay deferred till they are due.
+/// To cancel a timed job, stop the job.
+///
+/// The thread pool can run in elastic mode, with a minimum and a maximum number of threads. An elastic
+/// pool starts threads when its queued jobs wait longer than the spawn latency, and retires the
+/// threads which idle longer than the keep-alive time.
+///
+/// A job which blocks, for example on file I/O, should declare its blocking section with a
+/// BlockingScope. The pool starts a compensating thread for the blocked thread, so that the other jobs
+/// keep running.
+///
+/// The threads of the pool can be pinned to CPUs with an affinity policy. Pinned threads know their
+/// NUMA node, and in work stealing mode they steal jobs from the threads of their own node first.
+///
+/// A thread of the pool which yields, or waits for a job, a future or a parallel algorithm, runs the
+/// queued jobs of the pool meanwhile. This keeps the thread busy, and avoids the starvation of the pool
+/// when all its threads wait for jobs which are still queued. When the pool has no queued jobs, the
+/// waiting thread parks till a job gets queued, or the awaited job settles.
+///
 /// To stop the thread pool, call the stop() method. This makes the thread pool to stop accepting new
-/// jobs, waits till all the queued jobs get scheduled, and stops the threads.
+/// jobs, stops the queued and running jobs, and joins the threads. To let the queued jobs complete
+/// before the pool stops, call drain() with a deadline.
 ///
 /// You should not push jobs which would hold a thread for the entire lifetime of the application. If
 /// you need such scenarios, it is better to create dedicated threads for those.
@@ -65,32 +133,353 @@ public:
     {
         friend class ThreadPool;
         friend bool async(JobPtr);
+        friend bool async(ThreadPool*, JobPtr);
 
     protected:
         virtual ~BaseJob() = default;
-        /// Reports whether the queuing of the job is possible.
-        virtual bool canQueue() const = 0;
-        /// Queues the job.
-        virtual void queue() = 0;
+        /// Tries to queue the job. The call must be atomic, as the same job can be scheduled from
+        /// several threads at the same time.
+        /// \return If the job got queued, returns \e true, otherwise \e false.
+        virtual bool tryQueue() = 0;
+        /// Returns whether the job can get queued. A bounded pool checks it before the job takes a
+        /// place of the shared queues, so that a busy job neither takes a place, nor gets the overflow
+        /// policy applied.
+        virtual bool canQueue() const
+        {
+            return true;
+        }
         /// Schedules the job.
         virtual void schedule() = 0;
         /// Completes the job.
         virtual void complete() = 0;
+        /// Cancels the job. The thread pool cancels the queued and running jobs when it stops.
+        virtual void cancel() = 0;
+        /// Returns the priority of the job.
+        virtual JobPriority getPriority() const
+        {
+            return JobPriority::Normal;
+        }
+        /// Returns the deadline of the job. The jobs with a deadline are served before the other
+        /// jobs, in earliest deadline first order.
+        virtual std::chrono::steady_clock::time_point getDeadline() const
+        {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        /// Returns whether the job continues work the pool already accepted, like the activation of
+        /// a strand or of a pipeline stage. A bounded pool queues a continuation even when its shared
+        /// queues are full, and its overflow policies never drop a continuation.
+        virtual bool isContinuation() const
+        {
+            return false;
+        }
     };
     using BaseJobPtr = std::shared_ptr<BaseJob>;
 
+    /// The clock of the timed jobs.
+    using Clock = std::chrono::steady_clock;
+
+    /// A histogram of durations, with power of two buckets.
+    struct STEW_API Histogram
+    {
+        /// The number of buckets. The first bucket counts the zero durations, and bucket \e i counts the
+        /// durations from 2^(i-1) to 2^i nanoseconds. The last bucket also counts the longer durations.
+        static constexpr std::size_t BucketCount = 32u;
+
+        /// The number of durations in each bucket.
+        std::array<std::size_t, BucketCount> buckets = {};
+        /// The number of durations recorded.
+        std::size_t count = 0u;
+        /// The sum of the durations recorded.
+        std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+        /// The longest duration recorded.
+        std::chrono::nanoseconds max = std::chrono::nanoseconds::zero();
+
+        /// Returns the mean of the durations recorded.
+        /// \return The mean duration, or zero if the histogram is empty.
+        std::chrono::nanoseconds getMean() const;
+
+        /// Returns an upper bound of a percentile of the durations, the upper limit of the bucket which
+        /// holds the percentile.
+        /// \param percentile The percentile, between 0 and 100.
+        /// \return The upper bound of the percentile, or zero if the histogram is empty.
+        std::chrono::nanoseconds getPercentile(double percentile) const;
+    };
+
+    /// The metrics of a thread of the pool.
+    struct STEW_API WorkerMetrics
+    {
+        /// The time the thread ran jobs.
+        std::chrono::nanoseconds busyTime = std::chrono::nanoseconds::zero();
+        /// The time the thread parked, waiting for jobs.
+        std::chrono::nanoseconds idleTime = std::chrono::nanoseconds::zero();
+        /// The number of jobs the thread ran, including the jobs run while the thread helped.
+        std::size_t jobCount = 0u;
+        /// The number of jobs the thread stole from the other threads.
+        std::size_t stealCount = 0u;
+        /// The number of times the thread woke up from parking.
+        std::size_t wakeupCount = 0u;
+        /// Whether the thread runs.
+        bool isActive = false;
+    };
+
+    /// A snapshot of the metrics of the pool. Each counter is read atomically, while the jobs keep
+    /// running, so the counters are not a consistent cut of the pool state.
+    struct STEW_API Metrics
+    {
+        /// The time the jobs waited in the queues before they started.
+        Histogram queueLatency;
+        /// The run times of the jobs.
+        Histogram runTime;
+        /// The metrics of the threads, by thread index. Holds the slots of the elastic and the
+        /// compensating threads too.
+        std::vector<WorkerMetrics> workers;
+        /// The number of queued jobs.
+        std::size_t queuedJobs = 0u;
+        /// The number of running jobs.
+        std::size_t runningJobs = 0u;
+        /// The number of running threads.
+        std::size_t threadCount = 0u;
+        /// The number of idle threads.
+        std::size_t idleCount = 0u;
+    };
+
+    /// The size of the preallocated task slots of the posted functions, in bytes. The slot holds the
+    /// function, and the bookkeeping of its task.
+    static constexpr std::size_t TaskSlotSize = 256u;
+
+    /// The scheduling modes of the thread pool.
+    enum class SchedulingMode
+    {
+        /// The threads of the pool serve the jobs from a single, shared queue.
+        SharedQueue,
+        /// Each thread of the pool has its own job queue, and steals jobs from the other threads
+        /// when its queue gets empty.
+        WorkStealing
+    };
+
+    /// The CPU affinity policies of the threads of the pool.
+    enum class AffinityPolicy
+    {
+        /// The threads are not pinned, the operating system places them.
+        None,
+        /// Each thread is pinned to a CPU. The threads fill the CPUs of a NUMA node before they get
+        /// pinned to the CPUs of the next node.
+        Compact,
+        /// Each thread is pinned to a CPU. The threads are distributed round robin across the NUMA
+        /// nodes.
+        Scatter,
+        /// Each thread is pinned to a CPU of an explicit CPU list, in the order of the list.
+        CpuList,
+        /// The threads are distributed round robin across the NUMA nodes, and each thread runs on any
+        /// CPU of its node. The threads of a node form a sub-pool.
+        NumaNode
+    };
+
+    /// The policies of a bounded thread pool, applied when a job gets scheduled while the shared
+    /// queues of the pool are full.
+    enum class OverflowPolicy
+    {
+        /// The job is rejected.
+        Reject,
+        /// The submitter blocks till the queues get a free place, or the block timeout elapses. A
+        /// thread of the pool runs the queued jobs of the pool meanwhile. If the timeout elapses, the
+        /// job is rejected.
+        Block,
+        /// The job runs on the thread which schedules it.
+        CallerRuns,
+        /// The oldest job of the shared queues, including the jobs with a deadline, gets stopped, and
+        /// the job takes its place. The continuations are not dropped.
+        DropOldest
+    };
+
+    /// The policies applied on a job which missed its deadline by the time a thread of the pool takes
+    /// it from the queue.
+    enum class MissedDeadlinePolicy
+    {
+        /// The job is stopped without running.
+        Skip,
+        /// The job loses its deadline for this run, and goes to the end of the background priority
+        /// queue.
+        Demote,
+        /// The job runs late.
+        Run
+    };
+
     /// Constructor. Creates a thread pool with a number of threads. The argument is ignored in
     /// single-threaded environment.
     explicit ThreadPool(std::size_t threadCount);
     /// Destructor. Aborts the application if the thread pool is still running.
     ~ThreadPool();
 
+    /// Sets the scheduling mode of the thread pool. You can only change the scheduling mode while
+    /// the thread pool is stopped.
+    /// \param mode The scheduling mode to set.
+    void setSchedulingMode(SchedulingMode mode);
+
+    /// Returns the scheduling mode of the thread pool.
+    /// \return The scheduling mode of the thread pool.
+    SchedulingMode getSchedulingMode() const;
+
+    /// Sets the maximum number of threads of the pool. If the maximum is greater than the thread
+    /// count of the pool, the pool runs in elastic mode: it starts new threads when the queued jobs wait
+    /// longer than the spawn latency, up to the maximum thread count, and retires these threads when
+    /// they idle for the keep-alive time. The thread count passed to the constructor is the minimum
+    /// number of threads. You can only change the maximum thread count while the thread pool is stopped.
+    /// \param maxThreadCount The maximum number of threads.
+    void setMaxThreadCount(std::size_t maxThreadCount);
+
+    /// Returns the maximum number of threads of the pool.
+    /// \return The maximum number of threads.
+    std::size_t getMaxThreadCount() const;
+
+    /// Sets the maximum number of threads the pool starts to compensate the threads blocked in a
+    /// BlockingScope. The default is the thread count of the pool. You can only change the maximum
+    /// while the thread pool is stopped.
+    /// \param count The maximum number of compensating threads.
+    void setMaxCompensatingThreadCount(std::size_t count);
+
+    /// Returns the maximum number of threads the pool starts to compensate the blocked threads.
+    /// \return The maximum number of compensating threads.
+    std::size_t getMaxCompensatingThreadCount() const;
+
+    /// Sets the queue latency after which an elastic pool starts a new thread.
+    /// \param latency The spawn latency.
+    void setSpawnLatency(const std::chrono::nanoseconds& latency);
+
+    /// Returns the queue latency after which an elastic pool starts a new thread.
+    /// \return The spawn latency.
+    std::chrono::nanoseconds getSpawnLatency() const;
+
+    /// Sets the time an elastic or compensating thread idles before it retires.
+    /// \param keepAlive The keep-alive time.
+    void setKeepAlive(const std::chrono::nanoseconds& keepAlive);
+
+    /// Returns the time an elastic thread idles before it retires.
+    /// \return The keep-alive time.
+    std::chrono::nanoseconds getKeepAlive() const;
+
+    /// Sets the CPU affinity policy of the threads of the pool. The threads get pinned when they
+    /// start. Pinning is best effort, a thread which cannot be pinned runs unpinned. You can only
+    /// change the affinity policy while the thread pool is stopped.
+    /// \param policy The affinity policy to set.
+    /// \param cpus The CPU list of the AffinityPolicy::CpuList policy. Ignored by the other policies.
+    void setAffinityPolicy(AffinityPolicy policy, std::vector<std::size_t> cpus = {});
+
+    /// Returns the CPU affinity policy of the threads of the pool.
+    /// \return The affinity policy of the threads.
+    AffinityPolicy getAffinityPolicy() const;
+
+    /// Sets the scheduling priority of the threads of the pool. The threads of a background priority
+    /// pool yield the CPUs to the threads of the other pools. The priority is applied when the threads
+    /// start, best effort, as raising the priority usually needs privileges. You can only change the
+    /// thread priority while the thread pool is stopped.
+    /// \param priority The thread priority to set.
+    void setThreadPriority(JobPriority priority);
+
+    /// Returns the scheduling priority of the threads of the pool.
+    /// \return The thread priority.
+    JobPriority getThreadPriority() const;
+
+    /// Sets the capacity of the shared queues of the pool. When the queues are full, the overflow
+    /// policy of the pool decides the fate of the scheduled job. The local queues of the threads in
+    /// work stealing mode are not bounded, and the continuations are queued beyond the capacity. You
+    /// can only change the capacity while the thread pool is stopped.
+    /// \param capacity The maximum number of jobs the shared queues hold. Zero means unbounded queues.
+    void setQueueCapacity(std::size_t capacity);
+
+    /// Returns the capacity of the shared queues of the pool.
+    /// \return The queue capacity, zero if the queues are unbounded.
+    std::size_t getQueueCapacity() const;
+
+    /// Sets the policy applied when a job gets scheduled while the shared queues are full. You can
+    /// only change the overflow policy while the thread pool is stopped.
+    /// \param policy The overflow policy.
+    void setOverflowPolicy(OverflowPolicy policy);
+
+    /// Returns the policy applied when a job gets scheduled while the shared queues are full.
+    /// \return The overflow policy.
+    OverflowPolicy getOverflowPolicy() const;
+
+    /// Sets the time a submitter blocks on full queues with the Block overflow policy. You can only
+    /// change the block timeout while the thread pool is stopped.
+    /// \param timeout The block timeout.
+    void setBlockTimeout(const std::chrono::nanoseconds& timeout);
+
+    /// Returns the time a submitter blocks on full queues with the Block overflow policy.
+    /// \return The block timeout.
+    std::chrono::nanoseconds getBlockTimeout() const;
+
+    /// Sets the idle strategy of the threads of the pool. A thread which runs out of jobs spins with
+    /// CPU pause hints, then yields, before it parks. A job queued while a thread spins starts without
+    /// the latency of waking a parked thread, at the cost of the CPU time burnt while spinning. Pass
+    /// zeros to park the idle threads right away. You can only change the idle strategy while the
+    /// thread pool is stopped.
+    /// \param spinCount The number of times an idle thread spins before it yields.
+    /// \param yieldCount The number of times an idle thread yields before it parks.
+    void setIdleSpinning(std::size_t spinCount, std::size_t yieldCount);
+
+    /// Returns the number of times an idle thread spins before it yields.
+    /// \return The spin count.
+    std::size_t getIdleSpinCount() const;
+
+    /// Returns the number of times an idle thread yields before it parks.
+    /// \return The yield count.
+    std::size_t getIdleYieldCount() const;
+
+    /// Sets the limit of the next job slot of the threads of the pool. The first normal priority job
+    /// a job schedules from a thread of the pool goes to the next job slot of the thread, and the
+    /// thread runs it next, on a warm cache. To keep the queued jobs from starving, a thread takes the
+    /// jobs of its slot in a row only up to the limit. The idle threads steal the slot jobs of the busy
+    /// threads. You can only change the limit while the thread pool is stopped.
+    /// \param limit The number of slot jobs a thread runs in a row. Zero disables the slot.
+    void setNextJobSlotLimit(std::size_t limit);
+
+    /// Returns the limit of the next job slot of the threads.
+    /// \return The number of slot jobs a thread runs in a row, zero if the slot is disabled.
+    std::size_t getNextJobSlotLimit() const;
+
+    /// Returns the number of times an overflow policy got applied, since the thread pool got created.
+    /// \param policy The overflow policy.
+    /// \return The number of jobs scheduled on full queues with the policy.
+    std::size_t getOverflowCount(OverflowPolicy policy) const;
+
+    /// Sets the policy applied on the jobs which missed their deadline by the time a thread of the pool
+    /// takes them. You can only change the policy while the thread pool is stopped.
+    /// \param policy The missed deadline policy.
+    void setMissedDeadlinePolicy(MissedDeadlinePolicy policy);
+
+    /// Returns the policy applied on the jobs which missed their deadline.
+    /// \return The missed deadline policy.
+    MissedDeadlinePolicy getMissedDeadlinePolicy() const;
+
+    /// Returns the number of jobs which missed their deadline, since the thread pool got created.
+    /// \return The number of missed deadlines.
+    std::size_t getMissedDeadlineCount() const;
+
+    /// Sets the priority aging time of the thread pool. A job that waits in its queue for longer
+    /// than the aging time is served before the jobs of higher priority queued after it.
+    /// \param aging The priority aging time.
+    void setPriorityAging(const std::chrono::nanoseconds& aging);
+
+    /// Returns the priority aging time of the thread pool.
+    /// \return The priority aging time.
+    std::chrono::nanoseconds getPriorityAging() const;
+
     /// Starts the thread pool.
     void start();
 
-    /// Stops the thread pool.
+    /// Stops the thread pool. Stops the queued and the running jobs, and joins the threads of the pool
+    /// when their running jobs return.
     void stop();
 
+    /// Drains the thread pool, then stops it. Waits till the queued and the running jobs complete, or
+    /// the deadline passes. The pool accepts jobs while draining, so that the jobs can schedule their
+    /// follow-up jobs. The jobs which did not complete by the deadline are stopped. Call the method
+    /// from a thread which is not a thread of the pool.
+    /// \param deadline The time till the pool waits for its jobs to complete.
+    /// \return If all the jobs completed before the deadline, returns \e true, otherwise \e false.
+    bool drain(Clock::time_point deadline);
+
     /// Returns whether the thread pool is busy executing jobs.
     /// \return If the thread pool is executing jobs, returns \e true, otherwise \e false.
     bool isBusy();
@@ -103,7 +492,8 @@ public:
     /// \return If the thread pool got signalled to stop, returns \e true, otherwise \e false.
     bool isStopSignalled() const;
 
-    /// Returns the number of running threads of a thread pool.
+    /// Returns the number of running threads of a thread pool. In elastic mode, the number changes
+    /// while the pool runs.
     /// \return The number of threads running. If the thread pool is stopped, returns 0u.
     std::size_t getThreadCount() const;
 
@@ -116,37 +506,251 @@ public:
     /// \returns If the job was queued with success. returns \e true, otherwise \e false.
     bool tryScheduleJob(JobPtr job);
 
-    /// Queue multiple jobs for execution.
+    /// Queues a task for execution. A task is a job which implements the BaseJob interface directly.
+    /// \param task The task to queue for execution.
+    /// \returns If the task was queued with success. returns \e true, otherwise \e false.
+    bool tryScheduleTask(BaseJobPtr task);
+
+    /// Posts a fire-and-forget function for execution. Unlike a job, the function can not be stopped
+    /// or waited for. If the thread pool stops before the function runs, the function is dropped. The
+    /// function must not throw.
+    ///
+    /// A function whose task fits in a task slot is stored in a preallocated slot of the pool. The
+    /// threads of the pool recycle the slots of the tasks they run, so posting small functions costs
+    /// no heap allocation once the pool has warmed up.
+    /// \tparam Function The function type.
+    /// \param function The function to post.
+    /// \returns If the function got queued with success, returns \e true, otherwise \e false.
+    template <typename Function>
+        requires std::invocable<std::decay_t<Function>&>
+    bool post(Function&& function);
+
+    /// Queue multiple jobs for execution. The jobs are pushed to the queues in batches, and as many
+    /// idle threads are woken up as many jobs got queued.
+    /// \param jobs The jobs to queue for execution.
+    /// \returns The number of jobs pushed with success.
+    std::size_t tryScheduleJobs(std::span<const JobPtr> jobs);
+
+    /// Queue multiple jobs for execution. Moves the handles of the queued jobs out of the vector, the
+    /// handles of the jobs which failed to queue stay in the vector.
     /// \param jobs The jobs to queue for execution.
     /// \returns The number of jobs pushed with success.
-    std::size_t tryScheduleJobs(std::vector<JobPtr> jobs);
+    std::size_t tryScheduleJobs(std::vector<JobPtr>&& jobs);
+
+    /// Schedules a job for execution after a delay. If the job is busy when due, or the queues of a
+    /// bounded pool are full, the timer retries to queue the job till it gets queued, or stopped. The
+    /// timer never blocks on full queues, and never runs the job on its thread.
+    /// \param job The job to schedule.
+    /// \param delay The delay after which to queue the job.
+    /// \return If the job got scheduled with success, returns \e true, otherwise \e false.
+    bool scheduleAfter(JobPtr job, const std::chrono::nanoseconds& delay);
+
+    /// Schedules a job for execution at a given time. The job is queued like scheduleAfter() does.
+    /// \param job The job to schedule.
+    /// \param timePoint The time when to queue the job.
+    /// \return If the job got scheduled with success, returns \e true, otherwise \e false.
+    bool scheduleAt(JobPtr job, Clock::time_point timePoint);
+
+    /// Schedules a job for periodic execution. The first run of the job is due after one period. If
+    /// the job is still busy when its next run is due, or the queues of a bounded pool are full, the
+    /// run is skipped. The job runs periodically till it gets stopped, or the thread pool stops.
+    /// \param job The job to schedule.
+    /// \param period The period of the job.
+    /// \return If the job got scheduled with success, returns \e true, otherwise \e false.
+    bool schedulePeriodic(JobPtr job, const std::chrono::nanoseconds& period);
 
     /// Returns the queued job count.
     /// \return The queued job count.
     std::size_t getQueuedJobs() const;
 
+    /// Returns a snapshot of the metrics of the thread pool. The metrics of the threads are kept till
+    /// the thread pool stops.
+    /// \return The metrics of the thread pool.
+    Metrics getMetrics() const;
+
+    /// Returns the queued job count of a priority class.
+    /// \param priority The priority class.
+    /// \return The queued job count of the priority class.
+    std::size_t getQueuedJobs(JobPriority priority) const;
+
     /// Schedules the jobs queued. On single multi-threaded environment, the function yields the
-    /// current thread. On single-threaded environment, executes the queued jobs.
+    /// current thread. On single-threaded environment, executes the queued jobs. When called from a
+    /// thread of the pool, runs a queued job of the pool, or yields the thread if there is none.
     void schedule();
 
     /// Schedules the jobs queued with a delay. On single multi-threaded environment, the function
     /// yields the current thread with a given delay. On single-threaded environment, executes the
-    /// queued tasks.
+    /// queued tasks. When called from a thread of the pool, runs the queued jobs of the pool till the
+    /// delay elapses.
     /// \param delay The delay after which to schedule the jobs.
     void schedule(const std::chrono::nanoseconds& delay);
 
+    /// Waits till a condition holds. Call it from a thread of the pool. The thread runs the queued
+    /// jobs of the pool while it waits. When the pool has no queued jobs, the thread parks till a job
+    /// gets queued, or till notifyWaiters() gets called.
+    /// \param condition The condition to wait for.
+    void waitUntil(const std::function<bool()>& condition);
+
+    /// Wakes the threads which wait in waitUntil(), so that they check their conditions. Call it after
+    /// changing a state which a waiting thread may wait for.
+    static void notifyWaiters();
+
+    /// Returns the thread pool of the calling thread.
+    /// \return The thread pool the calling thread belongs to, or \e nullptr if the calling thread is not
+    ///         a thread of a thread pool.
+    static ThreadPool* getCurrent();
+
 private:
+    friend class BlockingScope;
+    template <typename T>
+    friend class detail::TaskSlotAllocator;
+
+    // Takes a task slot, and releases it.
+    void* allocateTaskSlot();
+    void deallocateTaskSlot(void* slot);
+
     struct Descriptor;
     std::unique_ptr<Descriptor> descriptor;
+};
+
+namespace detail
+{
+
+/// The allocator of the posted tasks. Allocates the tasks which fit in a task slot from the slots of a
+/// thread pool, and the larger ones from the heap.
+template <typename T>
+class STEW_TEMPLATE_API TaskSlotAllocator
+{
+public:
+    using value_type = T;
+
+    explicit TaskSlotAllocator(ThreadPool& pool) noexcept :
+        m_pool(&pool)
+    {
+    }
+    template <typename U>
+    TaskSlotAllocator(const TaskSlotAllocator<U>& other) noexcept :
+        m_pool(other.m_pool)
+    {
+    }
+
+    T* allocate(std::size_t count)
+    {
+        if (fitsInSlot(count))
+        {
+            return static_cast<T*>(m_pool->allocateTaskSlot());
+        }
+        return std::allocator<T>().allocate(count);
+    }
+    void deallocate(T* pointer, std::size_t count) noexcept
+    {
+        if (fitsInSlot(count))
+        {
+            m_pool->deallocateTaskSlot(pointer);
+            return;
+        }
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    template <typename U>
+    bool operator==(const TaskSlotAllocator<U>& other) const noexcept
+    {
+        return m_pool == other.m_pool;
+    }
+
+private:
+    template <typename U>
+    friend class TaskSlotAllocator;
+
+    static constexpr bool fitsInSlot(std::size_t count)
+    {
+        return count == 1u && sizeof(T) <= ThreadPool::TaskSlotSize && alignof(T) <= alignof(std::max_align_t);
+    }
+
+    ThreadPool* m_pool = nullptr;
+};
+
+/// The task of a function posted to a thread pool.
+template <typename Function>
+class STEW_TEMPLATE_API PostedTask : public ThreadPool::BaseJob
+{
+public:
+    template <typename FunctionType>
+    explicit PostedTask(FunctionType&& function) :
+        m_function(std::forward<FunctionType>(function))
+    {
+    }
+
+protected:
+    /// A posted task is queued only once, when it gets posted.
+    bool tryQueue() override
+    {
+        return true;
+    }
+    void schedule() override
+    {
+        m_function();
+    }
+    void complete() override
+    {
+    }
+    void cancel() override
+    {
+    }
+
+private:
+    Function m_function;
+};
+
+} // namespace detail
+
+template <typename Function>
+    requires std::invocable<std::decay_t<Function>&>
+bool ThreadPool::post(Function&& function)
+{
+    using Task = detail::PostedTask<std::decay_t<Function>>;
+    auto task = std::allocate_shared<Task>(detail::TaskSlotAllocator<Task>(*this), std::forward<Function>(function));
+    return tryScheduleTask(std::move(task));
+}
+
+/// Declares a blocking section in a job, such as a file operation or a wait on an external event.
+/// While a thread of a pool is in a blocking scope, the pool wakes an idle thread, or starts a
+/// compensating thread, so that the blocked thread does not reduce the throughput of the pool. The
+/// compensating threads retire when they idle for the keep-alive time of the pool. Outside of a thread
+/// pool, the blocking scope does nothing.
+/// \code
+/// void run() override
+/// {
+///     std::string content;
+///     {
+///         BlockingScope blocking;
+///         content = readFile(m_path);
+///     }
+///     process(content);
+/// }
+/// \endcode
+class STEW_API BlockingScope
+{
+public:
+    /// Enters the blocking scope.
+    explicit BlockingScope();
+    /// Leaves the blocking scope.
+    ~BlockingScope();
+
+private:
+    DISABLE_COPY(BlockingScope);
+    DISABLE_MOVE(BlockingScope);
 
-    void runNextJob();
+    ThreadPool* m_pool = nullptr;
 };
 
 
-/// Yields the meta thread pool of the library.
+/// Yields the meta thread pool of the library. When called from a thread of a pool, yields the pool
+/// of the thread, and runs a queued job of that pool.
 void STEW_API yield();
 
-/// Yields the meta thread pool of the library with a given delay.
+/// Yields the meta thread pool of the library with a given delay. When called from a thread of a pool,
+/// runs the queued jobs of the pool of the thread till the delay elapses.
 /// \param delay The delay in nanoseconds with which to yield.
 void STEW_API yield(const std::chrono::nanoseconds& delay);
 
@@ -9,6 +9,10 @@ object.cpp
 object_extensions/object_extension.cpp
 object_extensions/signal.cpp
 tasks/job.cpp
+tasks/job_graph.cpp
+tasks/job_group.cpp
+tasks/pipeline.cpp
+tasks/serial_executor.cpp
 tasks/thread_pool.cpp
 template.cpp
 ../include/stew/arguments/argument.hpp
@@ -47,6 +51,13 @@ template.cpp
 ../include/stew/standalone/utility/type_traits.hpp
 ../include/stew/stew.hpp
 ../include/stew/stew_api.hpp
+../include/stew/tasks/coroutine.hpp
+../include/stew/tasks/future.hpp
 ../include/stew/tasks/job.hpp
+../include/stew/tasks/job_graph.hpp
+../include/stew/tasks/job_group.hpp
+../include/stew/tasks/parallel.hpp
+../include/stew/tasks/pipeline.hpp
+../include/stew/tasks/serial_executor.hpp
 ../include/stew/tasks/thread_pool.hpp
 )
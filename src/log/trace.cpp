@@ -38,23 +38,21 @@ struct TracerPrivate
 
         auto data = std::make_shared<const TraceRecord>(trace);
         auto job = self.shared_from_this();
-        auto successfulReschedule = false;
 
         while (!self.m_buffer.tryPush(data))
         {
             if (self.m_threadPool)
             {
-                successfulReschedule |= self.m_threadPool->tryScheduleJob(job);
+                self.m_threadPool->tryScheduleJob(job);
             }
             self.m_bufferOverflowCount++;
         }
 
         if (self.m_threadPool)
         {
-            if (!successfulReschedule)
-            {
-                self.m_threadPool->tryScheduleJob(job);
-            }
+            // Schedule after every push, as the tracer may have consumed the buffer after an earlier
+            // schedule.
+            self.m_threadPool->tryScheduleJob(job);
         }
         else
         {
@@ -77,6 +75,8 @@ struct TracerPrivate
 Tracer::Tracer(ThreadPool* threadPool) :
     m_threadPool(threadPool)
 {
+    // Flushing the logs must not delay the latency sensitive jobs.
+    setPriority(JobPriority::Background);
 }
 
 Tracer::~Tracer()
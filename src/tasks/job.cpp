@@ -19,37 +19,25 @@
 #include <stew/core/assert.hpp>
 #include <stew/tasks/job.hpp>
 
-#include <future>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace stew
 {
 
 struct Job::Descriptor
 {
-    // The worker task.
-    std::packaged_task<void(Job*)> worker;
     // The job status.
     std::atomic<Job::Status> status = Job::Status::Deferred;
-
-    static void main(Job* job)
-    {
-        if (job->isStopped())
-        {
-            return;
-        }
-
-        job->setStatus(Job::Status::Running);
-        job->run();
-        if (job->getStatus() != Job::Status::Stopped)
-        {
-            job->setStatus(Job::Status::Completed);
-        }
-    }
-
-    explicit Descriptor() :
-        worker(&Descriptor::main)
-    {
-    }
+    // The job priority.
+    std::atomic<JobPriority> priority = JobPriority::Normal;
+    // The job deadline, the maximum time point if the job has no deadline.
+    std::atomic<ThreadPool::Clock::time_point> deadline = ThreadPool::Clock::time_point::max();
+    // The completion handlers, guarded by the handler lock. The job settles under the lock, so that a
+    // handler is either added to a busy job, or rejected.
+    std::mutex handlerLock;
+    std::vector<Job::CompletionHandler> completionHandlers;
 
     bool isNextStatusValid(Job::Status nextStatus)
     {
@@ -70,7 +58,7 @@ struct Job::Descriptor
             }
             case Job::Status::Completed:
             {
-                return (nextStatus == Job::Status::Deferred || nextStatus == Job::Status::Stopped);
+                return (nextStatus == Job::Status::Deferred || nextStatus == Job::Status::Queued || nextStatus == Job::Status::Stopped);
             }
             case Job::Status::Stopped:
             {
@@ -96,33 +84,88 @@ Job::~Job()
     abortIfFail(descriptor->status == Status::Deferred || descriptor->status == Status::Stopped);
 }
 
-bool Job::canQueue() const
+bool Job::tryQueue()
 {
-    return descriptor->isNextStatusValid(Status::Queued);
+    // A deferred job, or a completed job which is not yet deferred can get queued. Claim the job
+    // atomically, as the job may be scheduled from several threads at the same time.
+    auto currentStatus = descriptor->status.load();
+    do
+    {
+        if (currentStatus != Status::Deferred && currentStatus != Status::Completed)
+        {
+            return false;
+        }
+    } while (!descriptor->status.compare_exchange_weak(currentStatus, Status::Queued));
+    descriptor->status.notify_all();
+
+    onQueued();
+    return true;
 }
 
-void Job::queue()
+bool Job::canQueue() const
 {
-    descriptor->worker.reset();
-    setStatus(Job::Status::Queued);
-    onQueued();
+    const auto currentStatus = descriptor->status.load();
+    return currentStatus == Status::Deferred || currentStatus == Status::Completed;
 }
 
 void Job::schedule()
 {
-    if (!isStopped())
+    // Claim the queued job atomically, as the job may get stopped from an other thread meanwhile. A
+    // stopped job does not run.
+    auto currentStatus = Status::Queued;
+    if (!descriptor->status.compare_exchange_strong(currentStatus, Status::Running))
     {
-        descriptor->worker(this);
+        abortIfFail(currentStatus == Status::Stopped);
+        return;
+    }
+    descriptor->status.notify_all();
+
+    try
+    {
+        run();
+    }
+    catch (...)
+    {
+        // An exception of the job does not unwind the thread which runs the job.
+    }
+    // Complete the job after it returns, so that a completed job is safe to reschedule.
+    currentStatus = Status::Running;
+    if (descriptor->status.compare_exchange_strong(currentStatus, Status::Completed))
+    {
+        descriptor->status.notify_all();
     }
 }
 
 void Job::complete()
 {
-    if (descriptor->status.load() == Status::Completed)
+    // Call the completion handler while the job is still completed, so that the job can reschedule
+    // itself before it gets deferred. A rescheduled job must not be deferred.
+    onCompleted();
+    std::vector<CompletionHandler> handlers;
     {
-        setStatus(Job::Status::Deferred);
+        std::lock_guard<std::mutex> lock(descriptor->handlerLock);
+        auto currentStatus = Status::Completed;
+        if (!descriptor->status.compare_exchange_strong(currentStatus, Status::Deferred))
+        {
+            return;
+        }
+        handlers.swap(descriptor->completionHandlers);
+    }
+    descriptor->status.notify_all();
+
+    for (auto& handler : handlers)
+    {
+        handler(Status::Completed);
+    }
+    ThreadPool::notifyWaiters();
+}
+
+void Job::cancel()
+{
+    if (!isStopped())
+    {
+        stop();
     }
-    onCompleted();
 }
 
 Job::Status Job::getStatus() const
@@ -135,13 +178,47 @@ void Job::setStatus(Status status)
     abortIfFail(descriptor->isNextStatusValid(status));
     auto currentStatus = descriptor->status.load();
     // If the current status has changed, abort.
-    abortIfFail(descriptor->status.compare_exchange_weak(currentStatus, status));
+    abortIfFail(descriptor->status.compare_exchange_strong(currentStatus, status));
+    descriptor->status.notify_all();
+}
+
+JobPriority Job::getPriority() const
+{
+    return descriptor->priority;
+}
+
+void Job::setPriority(JobPriority priority)
+{
+    descriptor->priority = priority;
+}
+
+ThreadPool::Clock::time_point Job::getDeadline() const
+{
+    return descriptor->deadline;
+}
+
+void Job::setDeadline(ThreadPool::Clock::time_point deadline)
+{
+    descriptor->deadline = deadline;
 }
 
 void Job::stop()
 {
-    setStatus(Status::Stopped);
+    // A job can be stopped in any status, also while the pool changes its status.
+    std::vector<CompletionHandler> handlers;
+    {
+        std::lock_guard<std::mutex> lock(descriptor->handlerLock);
+        descriptor->status.store(Status::Stopped);
+        handlers.swap(descriptor->completionHandlers);
+    }
+    descriptor->status.notify_all();
     stopOverride();
+
+    for (auto& handler : handlers)
+    {
+        handler(Status::Stopped);
+    }
+    ThreadPool::notifyWaiters();
 }
 
 bool Job::isStopped() const
@@ -158,7 +235,28 @@ bool Job::isBusy() const
 
 void Job::wait()
 {
-    descriptor->worker.get_future().wait();
+    // Wait till the job settles. A job which reschedules itself on completion stays busy till the
+    // rescheduled runs complete. A thread of a pool runs the queued jobs of its pool meanwhile.
+    if (auto pool = ThreadPool::getCurrent())
+    {
+        pool->waitUntil([this]() { return !isBusy(); });
+        return;
+    }
+    for (auto status = getStatus(); status == Status::Queued || status == Status::Running || status == Status::Completed; status = getStatus())
+    {
+        descriptor->status.wait(status);
+    }
+}
+
+bool Job::addCompletionHandler(CompletionHandler handler)
+{
+    std::lock_guard<std::mutex> lock(descriptor->handlerLock);
+    if (!isBusy())
+    {
+        return false;
+    }
+    descriptor->completionHandlers.push_back(std::move(handler));
+    return true;
 }
 
 } // namespace stew
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <stew/core/assert.hpp>
+#include <stew/tasks/job_graph.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace stew
+{
+
+struct JobGraph::Descriptor : public std::enable_shared_from_this<JobGraph::Descriptor>
+{
+    struct Node
+    {
+        JobPtr job;
+        std::vector<Node*> successors;
+        std::size_t predecessorCount = 0u;
+        // The predecessors which did not yet complete in the current run.
+        std::atomic_size_t pendingPredecessors = 0u;
+        // Claimed by the thread which schedules the node, or by the stop of the graph.
+        std::atomic_bool claimed = false;
+    };
+
+    ThreadPool* pool = nullptr;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::unordered_map<Job*, Node*> nodeMap;
+    // The nodes which did not yet settle in the current run.
+    std::atomic_size_t pendingNodes = 0u;
+    std::atomic_bool stopSignalled = false;
+
+    explicit Descriptor(ThreadPool* pool) :
+        pool(pool)
+    {
+    }
+
+    Node& addNode(JobPtr job)
+    {
+        abortIfFail(job);
+        auto it = nodeMap.find(job.get());
+        if (it != nodeMap.end())
+        {
+            return *it->second;
+        }
+        auto node = std::make_unique<Node>();
+        node->job = std::move(job);
+        auto& result = *node;
+        nodeMap.insert({result.job.get(), &result});
+        nodes.push_back(std::move(node));
+        return result;
+    }
+
+    // Checks the dependencies of the graph for cycles by peeling off the nodes with no predecessors.
+    bool isAcyclic() const
+    {
+        std::unordered_map<const Node*, std::size_t> predecessorCounts;
+        std::vector<const Node*> roots;
+        for (auto& node : nodes)
+        {
+            predecessorCounts[node.get()] = node->predecessorCount;
+            if (node->predecessorCount == 0u)
+            {
+                roots.push_back(node.get());
+            }
+        }
+
+        auto visitedCount = std::size_t(0u);
+        while (!roots.empty())
+        {
+            auto node = roots.back();
+            roots.pop_back();
+            ++visitedCount;
+            for (auto successor : node->successors)
+            {
+                if (--predecessorCounts[successor] == 0u)
+                {
+                    roots.push_back(successor);
+                }
+            }
+        }
+        return visitedCount == nodes.size();
+    }
+
+    void submit(Node& node)
+    {
+        if (node.claimed.exchange(true))
+        {
+            // The graph got stopped.
+            return;
+        }
+
+        auto& job = node.job;
+        auto pool = this->pool ? this->pool : Library::instance().threadPool();
+        const auto scheduled = pool ? pool->tryScheduleJob(job) : async(job);
+        if (!scheduled)
+        {
+            job->stop();
+            settle(node, Job::Status::Stopped);
+            return;
+        }
+
+        auto self = shared_from_this();
+        auto handler = [self, &node](Job::Status status)
+        {
+            self->settle(node, status);
+        };
+        if (!job->addCompletionHandler(handler))
+        {
+            // The job settled before the handler got added.
+            handler(job->isStopped() ? Job::Status::Stopped : Job::Status::Completed);
+        }
+        else if (stopSignalled)
+        {
+            // The graph got stopped while the job was scheduled.
+            job->stop();
+        }
+    }
+
+    void settle(Node& node, Job::Status status)
+    {
+        if (status == Job::Status::Completed && !stopSignalled)
+        {
+            for (auto successor : node.successors)
+            {
+                if (successor->pendingPredecessors.fetch_sub(1u) == 1u)
+                {
+                    submit(*successor);
+                }
+            }
+        }
+        else
+        {
+            stop();
+        }
+
+        if (pendingNodes.fetch_sub(1u) == 1u)
+        {
+            pendingNodes.notify_all();
+            ThreadPool::notifyWaiters();
+        }
+    }
+
+    void stop()
+    {
+        if (stopSignalled.exchange(true))
+        {
+            return;
+        }
+
+        for (auto& node : nodes)
+        {
+            if (!node->claimed.exchange(true))
+            {
+                // The node is not scheduled, stop it without running.
+                node->job->stop();
+                settle(*node, Job::Status::Stopped);
+            }
+            else if (node->job->isBusy())
+            {
+                // The completion handler of the node settles the node.
+                node->job->stop();
+            }
+        }
+    }
+};
+
+
+JobGraph::JobGraph(ThreadPool* pool) :
+    descriptor(std::make_shared<Descriptor>(pool))
+{
+}
+
+JobGraph::~JobGraph()
+{
+    if (isRunning())
+    {
+        stop();
+        wait();
+    }
+}
+
+void JobGraph::addJob(JobPtr job)
+{
+    abortIfFail(!isRunning());
+    descriptor->addNode(std::move(job));
+}
+
+void JobGraph::addDependency(JobPtr predecessor, JobPtr successor)
+{
+    abortIfFail(!isRunning());
+    abortIfFail(predecessor != successor);
+
+    auto& predecessorNode = descriptor->addNode(std::move(predecessor));
+    auto& successorNode = descriptor->addNode(std::move(successor));
+    auto& successors = predecessorNode.successors;
+    if (std::find(successors.begin(), successors.end(), &successorNode) != successors.end())
+    {
+        return;
+    }
+    successors.push_back(&successorNode);
+    ++successorNode.predecessorCount;
+}
+
+std::size_t JobGraph::getJobCount() const
+{
+    return descriptor->nodes.size();
+}
+
+bool JobGraph::start()
+{
+    if (isRunning() || !descriptor->isAcyclic())
+    {
+        return false;
+    }
+
+    descriptor->stopSignalled = false;
+    for (auto& node : descriptor->nodes)
+    {
+        node->pendingPredecessors = node->predecessorCount;
+        node->claimed = false;
+    }
+    descriptor->pendingNodes = descriptor->nodes.size();
+
+    for (auto& node : descriptor->nodes)
+    {
+        if (node->predecessorCount == 0u)
+        {
+            descriptor->submit(*node);
+        }
+    }
+    return true;
+}
+
+void JobGraph::stop()
+{
+    if (isRunning())
+    {
+        descriptor->stop();
+    }
+}
+
+void JobGraph::wait()
+{
+    // A thread of a pool runs the queued jobs of its pool while it waits.
+    if (auto pool = ThreadPool::getCurrent())
+    {
+        pool->waitUntil([this]() { return descriptor->pendingNodes == 0u; });
+        return;
+    }
+    for (auto pending = descriptor->pendingNodes.load(); pending > 0u; pending = descriptor->pendingNodes.load())
+    {
+        descriptor->pendingNodes.wait(pending);
+    }
+}
+
+bool JobGraph::isRunning() const
+{
+    return descriptor->pendingNodes > 0u;
+}
+
+bool JobGraph::isStopped() const
+{
+    return descriptor->stopSignalled;
+}
+
+} // namespace stew
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <stew/core/assert.hpp>
+#include <stew/tasks/job_group.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace stew
+{
+
+struct JobGroup::Descriptor : public std::enable_shared_from_this<JobGroup::Descriptor>
+{
+    using Clock = ThreadPool::Clock;
+
+    struct Member
+    {
+        JobPtr job;
+        Clock::time_point addedAt;
+    };
+
+    ThreadPool* pool = nullptr;
+    // Locks the members and the timing of the group.
+    mutable std::mutex lock;
+    // The pending jobs of the group.
+    std::unordered_map<Job*, Member> members;
+    Timing timing;
+    // The time since the group has pending jobs.
+    Clock::time_point busySince;
+    // The number of pending jobs. Waiters wait on the counter without locking the group.
+    std::atomic_size_t pendingCount = 0u;
+
+    explicit Descriptor(ThreadPool* pool) :
+        pool(pool)
+    {
+    }
+
+    // Adds a job to the group. Returns false if the job is already a pending job of the group.
+    bool join(const JobPtr& job)
+    {
+        GuardLock guard(lock);
+        const auto now = Clock::now();
+        if (!members.insert({job.get(), {job, now}}).second)
+        {
+            return false;
+        }
+        if (pendingCount++ == 0u)
+        {
+            busySince = now;
+        }
+        return true;
+    }
+
+    // Removes a job from the group. Returns the job, so that the last reference of the job gets released
+    // outside of the lock. Returns null if the job already left the group.
+    JobPtr leave(Job* job, bool settled, Job::Status status)
+    {
+        JobPtr result;
+        {
+            GuardLock guard(lock);
+            auto it = members.find(job);
+            if (it == members.end())
+            {
+                return result;
+            }
+            const auto now = Clock::now();
+            if (settled)
+            {
+                const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - it->second.addedAt);
+                (status == Job::Status::Stopped ? timing.stoppedCount : timing.completedCount)++;
+                timing.totalLatency += latency;
+                timing.maxLatency = std::max(timing.maxLatency, latency);
+            }
+            result = std::move(it->second.job);
+            members.erase(it);
+            if (--pendingCount == 0u)
+            {
+                timing.busyTime += std::chrono::duration_cast<std::chrono::nanoseconds>(now - busySince);
+            }
+        }
+        pendingCount.notify_all();
+        ThreadPool::notifyWaiters();
+        return result;
+    }
+};
+
+
+JobGroup::JobGroup(ThreadPool* pool) :
+    descriptor(std::make_shared<Descriptor>(pool))
+{
+}
+
+JobGroup::~JobGroup()
+{
+    cancelAll();
+    waitAll();
+}
+
+bool JobGroup::addJob(JobPtr job)
+{
+    abortIfFail(job);
+    // A pending job of the group is busy, the thread pool would reject it anyway.
+    if (!descriptor->join(job))
+    {
+        return false;
+    }
+
+    auto pool = descriptor->pool ? descriptor->pool : Library::instance().threadPool();
+    const auto scheduled = pool ? pool->tryScheduleJob(job) : async(job);
+    if (!scheduled)
+    {
+        descriptor->leave(job.get(), false, Job::Status::Stopped);
+        return false;
+    }
+
+    auto self = descriptor;
+    auto handler = [self, member = job.get()](Job::Status status)
+    {
+        self->leave(member, true, status);
+    };
+    if (!job->addCompletionHandler(handler))
+    {
+        // The job settled before the handler got added.
+        handler(job->isStopped() ? Job::Status::Stopped : Job::Status::Completed);
+    }
+    return true;
+}
+
+std::size_t JobGroup::getPendingCount() const
+{
+    return descriptor->pendingCount;
+}
+
+void JobGroup::waitAll()
+{
+    // A thread of a pool runs the queued jobs of its pool while it waits.
+    if (auto pool = ThreadPool::getCurrent())
+    {
+        pool->waitUntil([this]() { return descriptor->pendingCount == 0u; });
+        return;
+    }
+    for (auto pending = descriptor->pendingCount.load(); pending > 0u; pending = descriptor->pendingCount.load())
+    {
+        descriptor->pendingCount.wait(pending);
+    }
+}
+
+void JobGroup::cancelAll()
+{
+    std::vector<JobPtr> jobs;
+    {
+        GuardLock guard(descriptor->lock);
+        jobs.reserve(descriptor->members.size());
+        for (auto& member : descriptor->members)
+        {
+            jobs.push_back(member.second.job);
+        }
+    }
+    // The completion handlers of the stopped jobs remove the jobs from the group. A queued job which a
+    // thread of the pool takes meanwhile finds itself stopped, and does not run.
+    for (auto& job : jobs)
+    {
+        job->stop();
+    }
+}
+
+JobGroup::Timing JobGroup::getTiming() const
+{
+    GuardLock guard(descriptor->lock);
+    auto timing = descriptor->timing;
+    if (descriptor->pendingCount > 0u)
+    {
+        timing.busyTime += std::chrono::duration_cast<std::chrono::nanoseconds>(Descriptor::Clock::now() - descriptor->busySince);
+    }
+    return timing;
+}
+
+} // namespace stew
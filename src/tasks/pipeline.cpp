@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <stew/core/assert.hpp>
+#include <stew/stew.hpp>
+#include <stew/tasks/pipeline.hpp>
+
+namespace stew
+{
+
+struct PipelineStage::Descriptor
+{
+    // The thread pool of the stage. If null, the stage uses the thread pool of the library.
+    ThreadPool* pool = nullptr;
+    // The maximum number of items processed per activation.
+    const std::size_t batchSize = 0u;
+    // Locks the scheduled flag.
+    mutable std::mutex lock;
+    // Whether the stage is scheduled or runs. Only one activation of a stage exists at a time.
+    bool isScheduled = false;
+    // The metrics of the stage.
+    std::atomic_size_t processedCount = 0u;
+    std::atomic_size_t stallCount = 0u;
+    std::atomic<std::chrono::nanoseconds::rep> busyTime = 0;
+    const std::chrono::steady_clock::time_point createdAt = std::chrono::steady_clock::now();
+
+    explicit Descriptor(ThreadPool* pool, std::size_t batchSize) :
+        pool(pool),
+        batchSize(batchSize)
+    {
+    }
+
+    // Releases the stage if it has no work. Returns whether the stage got released. The channels
+    // notify the stage after they change, so checking the work under the lock loses no wakeup.
+    bool tryRelease(const PipelineStage& self)
+    {
+        GuardLock guard(lock);
+        if (!self.hasWork())
+        {
+            isScheduled = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Activates the stage. Without a thread pool, runs the stage on the calling thread.
+    bool activate(PipelineStage& self)
+    {
+        auto threadPool = pool ? pool : Library::instance().threadPool();
+        if (!threadPool)
+        {
+            do
+            {
+                self.schedule();
+            } while (!tryRelease(self));
+            return true;
+        }
+
+        if (threadPool->tryScheduleTask(self.shared_from_this()))
+        {
+            return true;
+        }
+        self.cancel();
+        return false;
+    }
+};
+
+
+double PipelineStage::Metrics::getThroughput() const
+{
+    if (elapsed <= std::chrono::nanoseconds::zero())
+    {
+        return 0.0;
+    }
+    return static_cast<double>(processedCount) / std::chrono::duration<double>(elapsed).count();
+}
+
+
+PipelineStage::PipelineStage(ThreadPool* pool, std::size_t batchSize) :
+    descriptor(std::make_unique<Descriptor>(pool, batchSize))
+{
+    abortIfFail(batchSize > 0u);
+}
+
+PipelineStage::~PipelineStage() = default;
+
+PipelineStage::Metrics PipelineStage::getMetrics() const
+{
+    Metrics metrics;
+    metrics.processedCount = descriptor->processedCount;
+    metrics.stallCount = descriptor->stallCount;
+    metrics.busyTime = std::chrono::nanoseconds(descriptor->busyTime.load());
+    metrics.elapsed = std::chrono::steady_clock::now() - descriptor->createdAt;
+    getChannelMetrics(metrics);
+    return metrics;
+}
+
+void PipelineStage::notify()
+{
+    {
+        GuardLock lock(descriptor->lock);
+        if (descriptor->isScheduled || !hasWork())
+        {
+            // The running activation picks up the work.
+            return;
+        }
+        descriptor->isScheduled = true;
+    }
+    descriptor->activate(*this);
+}
+
+bool PipelineStage::tryQueue()
+{
+    // The scheduled flag guards the activations of the stage.
+    return true;
+}
+
+void PipelineStage::schedule()
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto processed = std::size_t(0u);
+    for (; processed < descriptor->batchSize; ++processed)
+    {
+        const auto progress = processNext();
+        if (progress == Progress::Stalled)
+        {
+            // The next stage activates this stage when it frees room.
+            ++descriptor->stallCount;
+            break;
+        }
+        if (progress == Progress::Empty)
+        {
+            break;
+        }
+    }
+    descriptor->processedCount += processed;
+    descriptor->busyTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PipelineStage::complete()
+{
+    // Release the stage when it has no more work, otherwise reschedule it to run the next batch.
+    if (!descriptor->tryRelease(*this))
+    {
+        descriptor->activate(*this);
+    }
+}
+
+void PipelineStage::cancel()
+{
+    // Drop the items outside the lock, as dropping them notifies the stage before.
+    dropItems();
+    GuardLock lock(descriptor->lock);
+    descriptor->isScheduled = false;
+}
+
+bool PipelineStage::isContinuation() const
+{
+    // The activations of a stage continue the items of its channel. Dropping an activation would drop
+    // all the items of the channel.
+    return true;
+}
+
+} // namespace stew
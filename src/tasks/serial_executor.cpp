@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include <stew/core/assert.hpp>
+#include <stew/stew.hpp>
+#include <stew/tasks/serial_executor.hpp>
+
+#include <deque>
+#include <mutex>
+
+namespace stew
+{
+
+struct SerialExecutor::Strand::Descriptor
+{
+    // The thread pool of the strand. If null, the strand uses the thread pool of the library.
+    ThreadPool* pool = nullptr;
+    // The maximum number of tasks run per activation.
+    const std::size_t batchSize = 0u;
+    // Locks the tasks and the scheduled flag.
+    mutable std::mutex lock;
+    // The pending tasks.
+    std::deque<Task> tasks;
+    // Whether the strand is scheduled or runs. Only one activation of a strand exists at a time.
+    bool isScheduled = false;
+
+    // The strand which runs on the current thread.
+    static thread_local const Strand* current;
+
+    explicit Descriptor(ThreadPool* pool, std::size_t batchSize) :
+        pool(pool),
+        batchSize(batchSize)
+    {
+    }
+
+    // Releases the strand if it has no pending tasks. Returns whether the strand got released.
+    bool tryRelease()
+    {
+        GuardLock guard(lock);
+        if (tasks.empty())
+        {
+            isScheduled = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Activates the strand. Without a thread pool, runs the tasks of the strand on the calling thread.
+    bool activate(Strand& self)
+    {
+        auto threadPool = pool ? pool : Library::instance().threadPool();
+        if (!threadPool)
+        {
+            do
+            {
+                self.schedule();
+            } while (!tryRelease());
+            return true;
+        }
+
+        if (threadPool->tryScheduleTask(self.shared_from_this()))
+        {
+            return true;
+        }
+        self.cancel();
+        return false;
+    }
+};
+
+thread_local const SerialExecutor::Strand* SerialExecutor::Strand::Descriptor::current = nullptr;
+
+
+SerialExecutor::Strand::Strand(ThreadPool* pool, std::size_t batchSize) :
+    descriptor(std::make_unique<Descriptor>(pool, batchSize))
+{
+}
+
+SerialExecutor::Strand::~Strand() = default;
+
+bool SerialExecutor::Strand::post(Task task)
+{
+    abortIfFail(task);
+    {
+        GuardLock lock(descriptor->lock);
+        descriptor->tasks.push_back(std::move(task));
+        if (descriptor->isScheduled)
+        {
+            // The running activation picks up the task.
+            return true;
+        }
+        descriptor->isScheduled = true;
+    }
+    return descriptor->activate(*this);
+}
+
+std::size_t SerialExecutor::Strand::getPendingCount() const
+{
+    GuardLock lock(descriptor->lock);
+    return descriptor->tasks.size();
+}
+
+bool SerialExecutor::Strand::isCurrent() const
+{
+    return Descriptor::current == this;
+}
+
+bool SerialExecutor::Strand::tryQueue()
+{
+    // The scheduled flag guards the activations of the strand.
+    return true;
+}
+
+void SerialExecutor::Strand::schedule()
+{
+    auto previous = Descriptor::current;
+    Descriptor::current = this;
+    for (auto count = descriptor->batchSize; count > 0u; --count)
+    {
+        Task task;
+        {
+            GuardLock lock(descriptor->lock);
+            if (descriptor->tasks.empty())
+            {
+                break;
+            }
+            task = std::move(descriptor->tasks.front());
+            descriptor->tasks.pop_front();
+        }
+        task();
+    }
+    Descriptor::current = previous;
+}
+
+void SerialExecutor::Strand::complete()
+{
+    // Release the strand when it has no more tasks, otherwise reschedule it to run the next batch.
+    if (!descriptor->tryRelease())
+    {
+        descriptor->activate(*this);
+    }
+}
+
+void SerialExecutor::Strand::cancel()
+{
+    GuardLock lock(descriptor->lock);
+    descriptor->tasks.clear();
+    descriptor->isScheduled = false;
+}
+
+bool SerialExecutor::Strand::isContinuation() const
+{
+    // The activations of a strand continue its queued tasks. Dropping an activation would drop all
+    // the pending tasks of the strand.
+    return true;
+}
+
+
+SerialExecutor::SerialExecutor(ThreadPool* pool, std::size_t batchSize) :
+    m_pool(pool),
+    m_batchSize(batchSize)
+{
+    abortIfFail(batchSize > 0u);
+}
+
+SerialExecutor::StrandPtr SerialExecutor::createStrand()
+{
+    return StrandPtr(new Strand(m_pool, m_batchSize));
+}
+
+std::size_t SerialExecutor::getBatchSize() const
+{
+    return m_batchSize;
+}
+
+} // namespace stew
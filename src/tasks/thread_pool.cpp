@@ -19,122 +19,2089 @@
 #include <stew/tasks/job.hpp>
 #include <stew/tasks/thread_pool.hpp>
 #include <stew/core/assert.hpp>
+#include <stew/standalone/container/safe_queue.hpp>
 #include <stew/standalone/utility/scope_value.hpp>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <bitset>
+#include <cctype>
+#include <cmath>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <numeric>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(PLATFORM_CONFIG_HOST_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
 
 namespace stew
 {
 
+namespace
+{
+
+// The CPUs of the NUMA nodes of the host, by node.
+using CpuTopology = std::vector<std::vector<std::size_t>>;
+
+// Parses a CPU list of the form "0-3,8,10-11".
+std::vector<std::size_t> parseCpuList(const std::string& text)
+{
+    std::vector<std::size_t> cpus;
+    std::size_t position = 0u;
+    while (position < text.size())
+    {
+        auto end = text.find(',', position);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        const auto range = text.substr(position, end - position);
+        position = end + 1u;
+
+        const auto dash = range.find('-');
+        try
+        {
+            const auto first = std::stoul(range.substr(0u, dash));
+            const auto last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1u));
+            for (auto cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Skip the malformed ranges.
+        }
+    }
+    return cpus;
+}
+
+// Reads the NUMA topology of the host. If the topology is not available, assumes a single node with
+// all the CPUs of the host.
+CpuTopology readCpuTopology()
+{
+    CpuTopology topology;
+#if defined(PLATFORM_CONFIG_HOST_LINUX)
+    std::vector<std::pair<std::size_t, std::vector<std::size_t>>> nodes;
+    std::error_code error;
+    for (auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+    {
+        const auto name = entry.path().filename().string();
+        if (name.size() <= 4u || name.compare(0u, 4u, "node") != 0 || !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+        {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string cpuList;
+        if (std::getline(file, cpuList))
+        {
+            auto cpus = parseCpuList(cpuList);
+            if (!cpus.empty())
+            {
+                nodes.emplace_back(std::stoul(name.substr(4u)), std::move(cpus));
+            }
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+    for (auto& node : nodes)
+    {
+        topology.push_back(std::move(node.second));
+    }
+#endif
+    if (topology.empty())
+    {
+        topology.emplace_back(std::max(std::thread::hardware_concurrency(), 1u));
+        std::iota(topology.front().begin(), topology.front().end(), std::size_t(0u));
+    }
+    return topology;
+}
+
+// Pins the calling thread to a set of CPUs. Pinning is best effort: if the CPUs are not available to
+// the process, the thread stays unpinned.
+void pinCurrentThread(const std::vector<std::size_t>& cpus)
+{
+#if defined(PLATFORM_CONFIG_HOST_LINUX)
+    if (cpus.empty())
+    {
+        return;
+    }
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (auto cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &cpuSet);
+        }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+    (void)cpus;
+#endif
+}
+
+// Sets the scheduling priority of the calling thread. The normal priority leaves the thread as it is.
+// Raising the priority usually needs privileges, so it is best effort, like the pinning.
+void setCurrentThreadPriority(JobPriority priority)
+{
+#if defined(PLATFORM_CONFIG_HOST_LINUX)
+    if (priority == JobPriority::Normal)
+    {
+        return;
+    }
+    // On Linux, the nice value is an attribute of the thread.
+    setpriority(PRIO_PROCESS, 0, (priority == JobPriority::High) ? -5 : 10);
+#else
+    (void)priority;
+#endif
+}
+
+// Hints the CPU that the calling thread spins.
+inline void cpuRelax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+// The threads of the pools which wait in ThreadPool::waitUntil(). The threads of all the pools park on
+// the same condition, as the state a thread waits for may change on any thread.
+struct WaitingThreads
+{
+    std::mutex lock;
+    std::condition_variable condition;
+    std::atomic_size_t count = 0u;
+
+    // Wakes the waiting threads. The caller must order its state change before the call.
+    void wake()
+    {
+        if (count > 0u)
+        {
+            // Lock so that the notification does not get lost between a waiting thread checking its
+            // condition and starting to wait.
+            {
+                GuardLock guard(lock);
+            }
+            condition.notify_all();
+        }
+    }
+};
+
+WaitingThreads& getWaitingThreads()
+{
+    static WaitingThreads waitingThreads;
+    return waitingThreads;
+}
+
+} // namespace
+
 struct ThreadPool::Descriptor
 {
-    // The executor threads of the pool.
-    std::vector<std::thread> threads;
-    // The scheduled jobs.
-    std::deque<BaseJobPtr> jobs;
-    // The running jobs.
-    std::deque<BaseJobPtr> scheduledJobs;
+    // The number of priority classes.
+    static constexpr std::size_t PriorityCount = static_cast<std::size_t>(JobPriority::Background) + 1u;
+    // The number of overflow policies.
+    static constexpr std::size_t OverflowPolicyCount = static_cast<std::size_t>(OverflowPolicy::DropOldest) + 1u;
+    // The capacity of the inbound queue.
+    static constexpr std::size_t InboundQueueSize = 1024u;
+    // The delay after which the timer retries to queue a due one-shot job which failed to queue.
+    static constexpr std::chrono::milliseconds TimerRetryDelay{1};
+
+    // The outcome of scheduling a job on full queues.
+    enum class Admission
+    {
+        // The job got a place in the shared queues.
+        Reserved,
+        // The job ran on the calling thread.
+        Ran,
+        // The job got rejected.
+        Rejected
+    };
+
+    // A job of the shared queues, with the time it got queued.
+    struct QueueEntry
+    {
+        BaseJobPtr job;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    // A job of the deadline queue.
+    struct DeadlineEntry
+    {
+        BaseJobPtr job;
+        Clock::time_point queuedAt;
+        Clock::time_point deadline;
+        JobPriority priority;
+
+        // The heap of the deadline queue keeps the earliest deadline on top.
+        bool operator<(const DeadlineEntry& other) const
+        {
+            return deadline > other.deadline;
+        }
+    };
+
+    // A lock-free histogram of durations, with power of two buckets.
+    struct AtomicHistogram
+    {
+        std::array<std::atomic_size_t, Histogram::BucketCount> buckets = {};
+        std::atomic_size_t count = 0u;
+        std::atomic<std::int64_t> total = 0;
+        std::atomic<std::int64_t> max = 0;
+
+        void record(std::chrono::nanoseconds duration)
+        {
+            const auto value = std::max<std::int64_t>(duration.count(), 0);
+            const auto bucket = std::min<std::size_t>(std::bit_width(static_cast<std::uint64_t>(value)), Histogram::BucketCount - 1u);
+            buckets[bucket].fetch_add(1u, std::memory_order_relaxed);
+            count.fetch_add(1u, std::memory_order_relaxed);
+            total.fetch_add(value, std::memory_order_relaxed);
+            auto current = max.load(std::memory_order_relaxed);
+            while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // Adds the recorded durations to a histogram snapshot.
+        void addTo(Histogram& histogram) const
+        {
+            for (std::size_t i = 0u; i < Histogram::BucketCount; ++i)
+            {
+                histogram.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+            }
+            histogram.count += count.load(std::memory_order_relaxed);
+            histogram.total += std::chrono::nanoseconds(total.load(std::memory_order_relaxed));
+            histogram.max = std::max(histogram.max, std::chrono::nanoseconds(max.load(std::memory_order_relaxed)));
+        }
+    };
+
+    // A free task slot. The free slots form an intrusive list.
+    struct TaskSlot
+    {
+        TaskSlot* next = nullptr;
+    };
+    // The number of task slots allocated at once.
+    static constexpr std::size_t TaskSlotChunkSize = 64u;
+    // The maximum number of free task slots a worker keeps for itself.
+    static constexpr std::size_t WorkerTaskSlotCount = 64u;
+    static_assert(TaskSlotSize % alignof(std::max_align_t) == 0u, "Task slots must keep the alignment of their chunk.");
+
+    // The worker of a thread of the pool.
+    struct Worker
+    {
+        // The pool of the worker.
+        Descriptor& pool;
+        // The index of the worker.
+        const std::size_t index = 0u;
+        // The thread of the worker.
+        std::thread thread;
+        // Locks the local job queue and the running jobs of the worker.
+        std::mutex queueLock;
+        // The local job queue of the worker, used in work stealing mode.
+        std::deque<QueueEntry> jobs;
+        // The next job slot of the worker, which holds a job scheduled from the thread of the worker,
+        // and whether the slot holds a job. Only the thread of the worker fills the slot.
+        QueueEntry nextJob;
+        std::atomic_bool hasNextJob = false;
+        // The number of jobs the worker took from its next job slot in a row.
+        std::size_t nextJobRunCount = 0u;
+        // The NUMA node of the worker.
+        std::size_t node = 0u;
+        // The CPUs the thread of the worker is pinned to. Empty if the thread is not pinned.
+        std::vector<std::size_t> cpus;
+        // The jobs the worker runs. A job which yields or waits on the worker runs other jobs nested
+        // in it, so the innermost running job is the last one.
+        std::vector<BaseJobPtr> runningJobs;
+        // Whether the thread of the worker runs. The elastic workers start and retire while the pool
+        // runs.
+        std::atomic_bool isActive = false;
+        // The free task slots of the worker. Only the thread of the worker touches them.
+        TaskSlot* freeTaskSlots = nullptr;
+        std::size_t freeTaskSlotCount = 0u;
+        // The metrics of the worker. Only the thread of the worker updates them.
+        AtomicHistogram queueLatency;
+        AtomicHistogram runTime;
+        std::atomic<std::int64_t> busyTime = 0;
+        std::atomic<std::int64_t> idleTime = 0;
+        std::atomic_size_t jobCount = 0u;
+        std::atomic_size_t stealCount = 0u;
+        std::atomic_size_t wakeupCount = 0u;
+
+        explicit Worker(Descriptor& pool, std::size_t index) :
+            pool(pool),
+            index(index)
+        {
+        }
+    };
+
+    // A job scheduled on the timer of the pool.
+    struct TimerEntry
+    {
+        JobPtr job;
+        Clock::time_point dueTime;
+        // The period of a periodic job, zero for one-shot jobs.
+        std::chrono::nanoseconds period;
+
+        // The heap of the timer keeps the earliest due entry on top.
+        bool operator<(const TimerEntry& other) const
+        {
+            return dueTime > other.dueTime;
+        }
+    };
+
+    // The thread pool which owns the descriptor.
+    ThreadPool& owner;
+    // The chunks of the task slots, and the free task slots shared by the threads. The slots outlive
+    // the queues, which may hold posted tasks till the pool gets destroyed.
+    std::vector<std::unique_ptr<std::byte[]>> taskSlotChunks;
+    TaskSlot* freeTaskSlots = nullptr;
+    // Locks the shared task slots.
+    std::mutex taskSlotLock;
+    // The workers of the pool.
+    std::vector<std::unique_ptr<Worker>> workers;
+    // The scheduled jobs, by priority. In work stealing mode, these are the injection queues of the
+    // jobs scheduled from outside of the pool.
+    std::array<std::deque<QueueEntry>, PriorityCount> jobs;
+    // The number of jobs in the priority queues.
+    std::atomic_size_t lockedJobCount = 0u;
+    // The lock-free inbound queue of the normal priority jobs scheduled to the shared queues. The jobs
+    // move to the normal priority queue when a thread takes a job under the queue lock, and when the
+    // inbound queue is full, before the job which found it full.
+    MpmcQueue<QueueEntry> inboundJobs{InboundQueueSize};
+    // The heap of the scheduled jobs with a deadline, served before the jobs of the priority queues.
+    std::vector<DeadlineEntry> deadlineJobs;
+    // The number of jobs with a deadline.
+    std::atomic_size_t deadlineJobCount = 0u;
     // Locks the task queue.
     std::mutex queueLock;
     // Threads wait on new tasks.
     std::condition_variable lockCondition;
-    // The amount of threads to create.
+    // The drain waits on the pool to run out of jobs.
+    std::condition_variable drainCondition;
+    // The amount of threads to create. In elastic mode, this is the minimum number of threads.
     const std::size_t threadCount = 0u;
+    // The maximum number of threads in elastic mode.
+    std::size_t maxThreadCount = 0u;
+    // The queue latency after which an elastic pool starts a new thread.
+    std::chrono::nanoseconds spawnLatency = std::chrono::milliseconds(10);
+    // The time an elastic thread idles before it retires.
+    std::chrono::nanoseconds keepAlive = std::chrono::seconds(1);
+    // The maximum number of threads started to compensate the threads blocked in a blocking scope.
+    std::size_t maxCompensatingThreadCount = 0u;
+    // The number of running threads.
+    std::atomic_size_t activeThreadCount = 0u;
+    // The number of threads blocked in a blocking scope.
+    std::atomic_size_t blockedThreadCount = 0u;
+    // Locks the start of the elastic threads.
+    std::mutex spawnLock;
+    // The scheduling mode of the pool.
+    SchedulingMode schedulingMode = SchedulingMode::SharedQueue;
+    // The affinity policy of the threads, and the CPU list of the CpuList policy.
+    AffinityPolicy affinityPolicy = AffinityPolicy::None;
+    std::vector<std::size_t> affinityCpus;
+    // The scheduling priority of the threads.
+    JobPriority threadPriority = JobPriority::Normal;
+    // The time after which a queued job is served before the jobs of higher priority.
+    std::chrono::nanoseconds priorityAging = std::chrono::milliseconds(100);
+    // The capacity of the shared queues, zero if the queues are unbounded.
+    std::size_t queueCapacity = 0u;
+    // The policy applied when the shared queues are full, and the time the submitters block.
+    OverflowPolicy overflowPolicy = OverflowPolicy::Reject;
+    std::chrono::nanoseconds blockTimeout = std::chrono::milliseconds(100);
+    // The number of jobs in the shared queues, including the places reserved by the submitters.
+    std::atomic_size_t sharedJobCount = 0u;
+    // The number of submitters blocked on full queues.
+    std::atomic_size_t blockedSubmitterCount = 0u;
+    // The blocked submitters wait on a free place in the shared queues.
+    std::condition_variable spaceCondition;
+    // The number of times the overflow policies got applied, by policy.
+    std::array<std::atomic_size_t, OverflowPolicyCount> overflowCounts = {};
+    // The policy applied on the jobs which missed their deadline, and the number of missed deadlines.
+    MissedDeadlinePolicy missedDeadlinePolicy = MissedDeadlinePolicy::Skip;
+    std::atomic_size_t missedDeadlineCount = 0u;
     // The number of idling threads.
     std::atomic_size_t idleThreadCount = 0u;
+    // The number of threads waiting on new tasks.
+    std::atomic_size_t parkedThreadCount = 0u;
+    // The number of idle threads which spin or yield before they park.
+    std::atomic_size_t spinningThreadCount = 0u;
+    // The number of times an idle thread spins, then yields, before it parks.
+    std::size_t spinCount = 100u;
+    std::size_t yieldCount = 10u;
+    // The number of jobs a worker takes from its next job slot in a row, zero to disable the slot.
+    std::size_t nextJobSlotLimit = 3u;
+    // The number of queued jobs, including the jobs of the worker queues.
+    std::atomic_size_t queuedJobCount = 0u;
+    // The number of queued jobs by priority. The jobs of the worker queues are normal priority jobs.
+    std::array<std::atomic_size_t, PriorityCount> queuedJobCountByPriority = {};
+    // The number of jobs the workers run.
+    std::atomic_size_t runningJobCount = 0u;
+    // The heap of the timed jobs.
+    std::vector<TimerEntry> timers;
+    // Locks the timed jobs.
+    std::mutex timerLock;
+    // The timer thread waits on the earliest due timed job.
+    std::condition_variable timerCondition;
+    // The timer thread, started with the first timed job.
+    std::thread timerThread;
     // Tells the thread pool to stop executing.
     std::atomic_bool stopSignalled = false;
+    // Tells the workers to signal the drain when the pool runs out of jobs.
+    std::atomic_bool drainSignalled = false;
     // Whether the pool is running.
     std::atomic_bool isRunning = false;
 
-    explicit Descriptor(std::size_t threadCount) :
-        threadCount(threadCount)
+    // The worker of the current thread, if the thread is a thread of a pool.
+    static thread_local Worker* currentWorker;
+
+    explicit Descriptor(ThreadPool& owner, std::size_t threadCount) :
+        owner(owner),
+        threadCount(threadCount),
+        maxCompensatingThreadCount(threadCount)
+    {
+    }
+
+    // Returns the worker of the current thread, if the thread is a thread of this pool.
+    Worker* getCurrentWorker()
+    {
+        return (currentWorker && &currentWorker->pool == this) ? currentWorker : nullptr;
+    }
+
+    // Takes a free task slot. A worker takes the slots it freed first, then the shared slots. When
+    // there is no free slot, allocates a chunk of slots.
+    void* allocateTaskSlot()
+    {
+        auto worker = getCurrentWorker();
+        if (worker && worker->freeTaskSlots)
+        {
+            auto slot = worker->freeTaskSlots;
+            worker->freeTaskSlots = slot->next;
+            --worker->freeTaskSlotCount;
+            return slot;
+        }
+
+        GuardLock lock(taskSlotLock);
+        if (!freeTaskSlots)
+        {
+            auto& chunk = taskSlotChunks.emplace_back(new std::byte[TaskSlotSize * TaskSlotChunkSize]);
+            for (auto index = TaskSlotChunkSize; index > 0u; --index)
+            {
+                auto slot = new (chunk.get() + (index - 1u) * TaskSlotSize) TaskSlot;
+                slot->next = freeTaskSlots;
+                freeTaskSlots = slot;
+            }
+        }
+        auto slot = freeTaskSlots;
+        freeTaskSlots = slot->next;
+        return slot;
+    }
+
+    // Releases a task slot. A worker keeps the slots it frees for itself, up to a limit.
+    void deallocateTaskSlot(void* memory)
+    {
+        auto slot = new (memory) TaskSlot;
+        auto worker = getCurrentWorker();
+        if (worker && worker->freeTaskSlotCount < WorkerTaskSlotCount)
+        {
+            slot->next = worker->freeTaskSlots;
+            worker->freeTaskSlots = slot;
+            ++worker->freeTaskSlotCount;
+            return;
+        }
+
+        GuardLock lock(taskSlotLock);
+        slot->next = freeTaskSlots;
+        freeTaskSlots = slot;
+    }
+
+    // Returns the free task slots of a worker to the shared free slots, so that the slots are not lost
+    // when the thread of the worker exits. Call it from the thread of the worker.
+    void releaseTaskSlots(Worker& worker)
+    {
+        if (!worker.freeTaskSlots)
+        {
+            return;
+        }
+        auto last = worker.freeTaskSlots;
+        while (last->next)
+        {
+            last = last->next;
+        }
+
+        GuardLock lock(taskSlotLock);
+        last->next = freeTaskSlots;
+        freeTaskSlots = std::exchange(worker.freeTaskSlots, nullptr);
+        worker.freeTaskSlotCount = 0u;
+    }
+
+    // Adjusts the queued job counters of a priority.
+    void addQueuedJobs(JobPriority priority, std::size_t count)
+    {
+        queuedJobCount += count;
+        queuedJobCountByPriority[static_cast<std::size_t>(priority)] += count;
+    }
+    void removeQueuedJobs(JobPriority priority, std::size_t count)
+    {
+        queuedJobCount -= count;
+        queuedJobCountByPriority[static_cast<std::size_t>(priority)] -= count;
+    }
+
+    // Returns whether a job of a priority and deadline, scheduled from the current thread, goes to the
+    // shared queues. In work stealing mode, the normal priority jobs without a deadline scheduled from a
+    // worker go to the queue of the worker.
+    bool isSharedQueued(JobPriority priority, Clock::time_point deadline)
+    {
+        return schedulingMode != SchedulingMode::WorkStealing || priority != JobPriority::Normal || deadline != Clock::time_point::max() || !getCurrentWorker();
+    }
+
+    // Returns whether a job of a priority and deadline, scheduled from the current thread, goes to the
+    // next job slot of the worker of the thread. Only the normal priority jobs without a deadline go to
+    // the slot, when the slot is empty.
+    bool isNextJobQueued(JobPriority priority, Clock::time_point deadline)
+    {
+        if (nextJobSlotLimit == 0u || priority != JobPriority::Normal || deadline != Clock::time_point::max())
+        {
+            return false;
+        }
+        auto worker = getCurrentWorker();
+        return worker && !worker->hasNextJob;
+    }
+
+    // Takes the job of the next job slot of a worker.
+    QueueEntry takeNextJob(Worker& worker)
+    {
+        if (!worker.hasNextJob)
+        {
+            return {};
+        }
+        GuardLock lock(worker.queueLock);
+        if (!worker.nextJob.job)
+        {
+            return {};
+        }
+        worker.hasNextJob = false;
+        removeQueuedJobs(JobPriority::Normal, 1u);
+        return std::exchange(worker.nextJob, {});
+    }
+
+    // Pushes a job to the deadline queue. Call it with the queue locked.
+    void pushDeadlineJob(BaseJobPtr job, JobPriority priority, Clock::time_point deadline, Clock::time_point queuedAt)
+    {
+        addQueuedJobs(priority, 1u);
+        ++deadlineJobCount;
+        deadlineJobs.push_back({std::move(job), queuedAt, deadline, priority});
+        std::push_heap(deadlineJobs.begin(), deadlineJobs.end());
+    }
+
+    // Reserves a place in the shared queues. Returns false if the queues are full. A continuation gets
+    // its place beyond the capacity.
+    bool tryReservePlace(bool continuation = false)
+    {
+        auto count = sharedJobCount.load();
+        do
+        {
+            if (!continuation && queueCapacity > 0u && count >= queueCapacity)
+            {
+                return false;
+            }
+        } while (!sharedJobCount.compare_exchange_weak(count, count + 1u));
+        return true;
+    }
+
+    // Releases places of the shared queues, and wakes the blocked submitters. Call it with the queue
+    // locked.
+    void releasePlaces(std::size_t count)
+    {
+        sharedJobCount -= count;
+        if (blockedSubmitterCount > 0u)
+        {
+            spaceCondition.notify_all();
+        }
+    }
+
+    // Releases the place of a job taken from the inbound queue, without holding the queue lock. Locks
+    // the queue only to wake the blocked submitters.
+    void releaseInboundPlace()
+    {
+        --sharedJobCount;
+        if (blockedSubmitterCount > 0u)
+        {
+            GuardLock lock(queueLock);
+            spaceCondition.notify_all();
+        }
+    }
+
+    // Moves the jobs of the inbound queue to the normal priority queue. Call it with the queue locked.
+    void collectInboundJobs()
+    {
+        auto& queue = jobs[static_cast<std::size_t>(JobPriority::Normal)];
+        for (auto entry = inboundJobs.tryPop(); entry.job; entry = inboundJobs.tryPop())
+        {
+            queue.push_back(std::move(entry));
+            ++lockedJobCount;
+        }
+    }
+
+    // Applies the overflow policy on a job scheduled while the shared queues are full. A submitter
+    // which must not block gets its job rejected instead of blocking, or running the job.
+    Admission admitOverflow(const BaseJobPtr& job, bool mayBlock)
+    {
+        auto policy = overflowPolicy;
+        if (!mayBlock && (policy == OverflowPolicy::Block || policy == OverflowPolicy::CallerRuns))
+        {
+            policy = OverflowPolicy::Reject;
+        }
+        ++overflowCounts[static_cast<std::size_t>(policy)];
+        switch (policy)
+        {
+            case OverflowPolicy::Block:
+            {
+                return waitForPlace() ? Admission::Reserved : Admission::Rejected;
+            }
+            case OverflowPolicy::CallerRuns:
+            {
+                return runOnCaller(job) ? Admission::Ran : Admission::Rejected;
+            }
+            case OverflowPolicy::DropOldest:
+            {
+                return dropOldest() ? Admission::Reserved : Admission::Rejected;
+            }
+            default:
+            {
+                return Admission::Rejected;
+            }
+        }
+    }
+
+    // Queues a task. A submitter which must not block, like the timer thread, gets the task rejected
+    // when the shared queues are full, regardless of the overflow policy.
+    bool scheduleTask(BaseJobPtr task, bool mayBlock)
+    {
+        if (stopSignalled)
+        {
+            return false;
+        }
+
+        abortIfFail(task);
+        // Reject a busy job before it takes a place, as the overflow policy would drop or block for a
+        // job which fails to queue.
+        if (!task->canQueue())
+        {
+            return false;
+        }
+
+        const auto priority = task->getPriority();
+        const auto deadline = task->getDeadline();
+        const auto nextJob = isNextJobQueued(priority, deadline);
+        const auto shared = !nextJob && isSharedQueued(priority, deadline);
+        if (shared && !tryReservePlace(task->isContinuation()))
+        {
+            const auto admission = admitOverflow(task, mayBlock);
+            if (admission != Admission::Reserved)
+            {
+                return admission == Admission::Ran;
+            }
+        }
+
+        if (!task->tryQueue())
+        {
+            if (shared)
+            {
+                GuardLock lock(queueLock);
+                releasePlaces(1u);
+            }
+            return false;
+        }
+        pushJob(std::move(task), priority, deadline, nextJob);
+        stopLateJobs();
+        // The job of the next job slot runs on the calling worker once its current job returns. Waking
+        // a parked thread would only make it steal the job.
+        if (!nextJob)
+        {
+            wakeOne();
+        }
+
+        return true;
+    }
+
+    // Waits for a place in the shared queues till the block timeout elapses. A worker runs the queued
+    // jobs meanwhile, as all the workers blocking on full queues would never free a place.
+    bool waitForPlace()
+    {
+        const auto deadline = Clock::now() + blockTimeout;
+        if (auto worker = getCurrentWorker())
+        {
+            while (!tryReservePlace())
+            {
+                if (stopSignalled || Clock::now() >= deadline)
+                {
+                    return false;
+                }
+                if (!runQueuedJob(*worker))
+                {
+                    std::this_thread::yield();
+                }
+            }
+            return true;
+        }
+
+        bool reserved = false;
+        auto isReserved = [this, &reserved]()
+        {
+            if (stopSignalled)
+            {
+                return true;
+            }
+            reserved = tryReservePlace();
+            return reserved;
+        };
+        UniqueLock lock(queueLock);
+        ++blockedSubmitterCount;
+        spaceCondition.wait_until(lock, deadline, isReserved);
+        --blockedSubmitterCount;
+        return reserved;
+    }
+
+    // Runs a job on the calling thread. Returns whether the job ran.
+    bool runOnCaller(const BaseJobPtr& job)
+    {
+        if (!job->tryQueue())
+        {
+            return false;
+        }
+        if (auto worker = getCurrentWorker())
+        {
+            ++runningJobCount;
+            runJob(*worker, job);
+        }
+        else
+        {
+            job->schedule();
+            job->complete();
+        }
+        return true;
+    }
+
+    // Stops the oldest job of the shared queues, including the deadline queue, and hands its place
+    // over to the scheduled job. The continuations are not dropped. Returns false if the shared queues
+    // have no job to drop.
+    bool dropOldest()
+    {
+        auto isDroppable = [](auto& entry) { return !entry.job->isContinuation(); };
+        BaseJobPtr dropped;
+        {
+            GuardLock lock(queueLock);
+            collectInboundJobs();
+            auto oldestQueue = jobs.end();
+            std::deque<QueueEntry>::iterator oldest;
+            for (auto queue = jobs.begin(); queue != jobs.end(); ++queue)
+            {
+                auto entry = std::find_if(queue->begin(), queue->end(), isDroppable);
+                if (entry != queue->end() && (oldestQueue == jobs.end() || entry->queuedAt < oldest->queuedAt))
+                {
+                    oldestQueue = queue;
+                    oldest = entry;
+                }
+            }
+            // The deadline queue is ordered by deadline, look up its oldest job.
+            auto oldestDeadlineJob = deadlineJobs.end();
+            for (auto entry = deadlineJobs.begin(); entry != deadlineJobs.end(); ++entry)
+            {
+                if (isDroppable(*entry) && (oldestDeadlineJob == deadlineJobs.end() || entry->queuedAt < oldestDeadlineJob->queuedAt))
+                {
+                    oldestDeadlineJob = entry;
+                }
+            }
+
+            if (oldestDeadlineJob != deadlineJobs.end() && (oldestQueue == jobs.end() || oldestDeadlineJob->queuedAt < oldest->queuedAt))
+            {
+                dropped = std::move(oldestDeadlineJob->job);
+                removeQueuedJobs(oldestDeadlineJob->priority, 1u);
+                deadlineJobs.erase(oldestDeadlineJob);
+                std::make_heap(deadlineJobs.begin(), deadlineJobs.end());
+                --deadlineJobCount;
+            }
+            else if (oldestQueue != jobs.end())
+            {
+                dropped = std::move(oldest->job);
+                oldestQueue->erase(oldest);
+                --lockedJobCount;
+                removeQueuedJobs(static_cast<JobPriority>(oldestQueue - jobs.begin()), 1u);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        dropped->cancel();
+        return true;
+    }
+
+    // Pushes a queued job. A job which goes to the shared queues must have its place reserved. The
+    // queued job count is increased before the job gets pushed, so that it never goes below the number
+    // of jobs held in the queues. The normal priority jobs of the shared queues go to the lock-free
+    // inbound queue, unless it is full.
+    void pushJob(BaseJobPtr job, JobPriority priority, Clock::time_point deadline, bool nextJob)
+    {
+        if (nextJob)
+        {
+            auto worker = getCurrentWorker();
+            GuardLock lock(worker->queueLock);
+            addQueuedJobs(priority, 1u);
+            worker->nextJob = {std::move(job), Clock::now()};
+            worker->hasNextJob = true;
+        }
+        else if (!isSharedQueued(priority, deadline))
+        {
+            auto worker = getCurrentWorker();
+            GuardLock lock(worker->queueLock);
+            addQueuedJobs(priority, 1u);
+            worker->jobs.push_back({std::move(job), Clock::now()});
+        }
+        else if (deadline != Clock::time_point::max())
+        {
+            GuardLock lock(queueLock);
+            pushDeadlineJob(std::move(job), priority, deadline, Clock::now());
+        }
+        else
+        {
+            addQueuedJobs(priority, 1u);
+            QueueEntry entry = {std::move(job), Clock::now()};
+            if (priority == JobPriority::Normal && inboundJobs.tryPush(std::move(entry)))
+            {
+                return;
+            }
+            GuardLock lock(queueLock);
+            if (priority == JobPriority::Normal)
+            {
+                // Move the older jobs of the full inbound queue ahead of the job.
+                collectInboundJobs();
+            }
+            jobs[static_cast<std::size_t>(priority)].push_back(std::move(entry));
+            ++lockedJobCount;
+        }
+    }
+
+    // Queues a batch of jobs, and pushes the queued jobs with a single lock per chunk of jobs. The
+    // transfer function copies or moves the job handles into the queues. Returns the number of the
+    // jobs queued.
+    template <typename JobType, typename Transfer>
+    std::size_t pushJobs(std::span<JobType> batch, Transfer transfer)
+    {
+        constexpr std::size_t ChunkSize = 64u;
+
+        auto worker = (schedulingMode == SchedulingMode::WorkStealing) ? getCurrentWorker() : nullptr;
+        std::size_t result = 0u;
+        for (std::size_t offset = 0u; offset < batch.size(); offset += ChunkSize)
+        {
+            auto chunk = batch.subspan(offset, std::min(ChunkSize, batch.size() - offset));
+
+            // Queue the jobs outside of the locks, as queueing calls into the jobs.
+            std::bitset<ChunkSize> queued;
+            for (std::size_t i = 0u; i < chunk.size(); ++i)
+            {
+                queued[i] = static_cast<BaseJob*>(chunk[i].get())->tryQueue();
+            }
+            if (queued.none())
+            {
+                continue;
+            }
+            result += queued.count();
+
+            const auto now = std::chrono::steady_clock::now();
+            GuardLock lock(queueLock);
+            UniqueLock workerLock;
+            if (worker)
+            {
+                workerLock = UniqueLock(worker->queueLock);
+            }
+            for (std::size_t i = 0u; i < chunk.size(); ++i)
+            {
+                if (!queued[i])
+                {
+                    continue;
+                }
+                const auto priority = chunk[i]->getPriority();
+                const auto deadline = chunk[i]->getDeadline();
+                if (deadline != Clock::time_point::max())
+                {
+                    ++sharedJobCount;
+                    pushDeadlineJob(transfer(chunk[i]), priority, deadline, now);
+                    continue;
+                }
+                addQueuedJobs(priority, 1u);
+                if (worker && priority == JobPriority::Normal)
+                {
+                    worker->jobs.push_back({transfer(chunk[i]), now});
+                }
+                else
+                {
+                    ++sharedJobCount;
+                    ++lockedJobCount;
+                    jobs[static_cast<std::size_t>(priority)].push_back({transfer(chunk[i]), now});
+                }
+            }
+        }
+        return result;
+    }
+
+    // Wakes up as many parked threads as many jobs got queued.
+    void wakeWorkers(std::size_t jobCount)
+    {
+        getWaitingThreads().wake();
+        // The spinning threads pick up jobs without a wake up.
+        const auto spinning = spinningThreadCount.load();
+        jobCount = (jobCount > spinning) ? jobCount - spinning : 0u;
+        const auto parked = parkedThreadCount.load();
+        if (jobCount == 0u || parked == 0u)
+        {
+            return;
+        }
+
+        {
+            GuardLock lock(queueLock);
+        }
+        if (jobCount >= parked)
+        {
+            lockCondition.notify_all();
+            return;
+        }
+        while (jobCount-- > 0u)
+        {
+            lockCondition.notify_one();
+        }
+    }
+
+    // Wakes up a parked thread, if there is any, and no thread spins. A spinning thread picks up the
+    // queued jobs without a wake up.
+    void wakeOne()
+    {
+        getWaitingThreads().wake();
+        if (spinningThreadCount == 0u && parkedThreadCount > 0u)
+        {
+            // Lock the queue so that the notification does not get lost between the parking thread
+            // checking its wake condition and starting to wait.
+            {
+                GuardLock lock(queueLock);
+            }
+            lockCondition.notify_one();
+        }
+    }
+
+    QueueEntry takeFront(std::deque<QueueEntry>& queue)
+    {
+        auto entry = std::move(queue.front());
+        queue.pop_front();
+        removeQueuedJobs(JobPriority::Normal, 1u);
+        return entry;
+    }
+
+    QueueEntry takeBack(std::deque<QueueEntry>& queue)
+    {
+        auto entry = std::move(queue.back());
+        queue.pop_back();
+        removeQueuedJobs(JobPriority::Normal, 1u);
+        return entry;
+    }
+
+    // Takes the next job from the shared queues. Call it with the queue locked. Takes the job with the
+    // earliest deadline first. The jobs which missed their deadline are handled by the missed deadline
+    // policy; the skipped jobs are collected, so that the caller stops them after unlocking the queue.
+    // Without a job with deadline, takes the oldest job of the highest priority queue, unless a lower
+    // priority job waited beyond the aging time.
+    QueueEntry takeSharedJob(std::vector<BaseJobPtr>& skippedJobs)
+    {
+        while (!deadlineJobs.empty())
+        {
+            std::pop_heap(deadlineJobs.begin(), deadlineJobs.end());
+            auto entry = std::move(deadlineJobs.back());
+            deadlineJobs.pop_back();
+            --deadlineJobCount;
+            removeQueuedJobs(entry.priority, 1u);
+
+            const auto now = Clock::now();
+            if (entry.deadline >= now || missedDeadlinePolicy == MissedDeadlinePolicy::Run)
+            {
+                if (entry.deadline < now)
+                {
+                    ++missedDeadlineCount;
+                }
+                releasePlaces(1u);
+                return {std::move(entry.job), entry.queuedAt};
+            }
+
+            ++missedDeadlineCount;
+            if (missedDeadlinePolicy == MissedDeadlinePolicy::Demote)
+            {
+                // The job keeps its place in the shared queues.
+                addQueuedJobs(JobPriority::Background, 1u);
+                jobs[static_cast<std::size_t>(JobPriority::Background)].push_back({std::move(entry.job), now});
+                ++lockedJobCount;
+            }
+            else
+            {
+                releasePlaces(1u);
+                skippedJobs.push_back(std::move(entry.job));
+            }
+        }
+
+        collectInboundJobs();
+        auto first = std::find_if(jobs.begin(), jobs.end(), [](auto& queue) { return !queue.empty(); });
+        if (first == jobs.end())
+        {
+            return {};
+        }
+
+        auto selected = first;
+        if (std::any_of(first + 1, jobs.end(), [](auto& queue) { return !queue.empty(); }))
+        {
+            const auto now = std::chrono::steady_clock::now();
+            for (auto queue = first + 1; queue != jobs.end(); ++queue)
+            {
+                if (queue->empty() || now - queue->front().queuedAt < priorityAging)
+                {
+                    continue;
+                }
+                if (queue->front().queuedAt < selected->front().queuedAt)
+                {
+                    selected = queue;
+                }
+            }
+        }
+
+        auto entry = std::move(selected->front());
+        selected->pop_front();
+        --lockedJobCount;
+        removeQueuedJobs(static_cast<JobPriority>(selected - jobs.begin()), 1u);
+        releasePlaces(1u);
+        return entry;
+    }
+
+    // Takes the next job from the shared queues, and stops the jobs skipped for missing their
+    // deadline. When only the inbound queue holds jobs, takes the job without locking the queue.
+    QueueEntry tryTakeSharedJob()
+    {
+        if (lockedJobCount == 0u && deadlineJobCount == 0u)
+        {
+            auto entry = inboundJobs.tryPop();
+            if (entry.job)
+            {
+                removeQueuedJobs(JobPriority::Normal, 1u);
+                releaseInboundPlace();
+                return entry;
+            }
+            if (lockedJobCount == 0u && deadlineJobCount == 0u)
+            {
+                return {};
+            }
+        }
+
+        std::vector<BaseJobPtr> skippedJobs;
+        QueueEntry entry;
+        {
+            GuardLock lock(queueLock);
+            entry = takeSharedJob(skippedJobs);
+        }
+        for (auto& job : skippedJobs)
+        {
+            job->cancel();
+        }
+        if (!skippedJobs.empty() && !entry.job)
+        {
+            // The pool may have run out of jobs with the skipped ones.
+            signalDrained();
+        }
+        return entry;
+    }
+
+    // Tries to take the next job for a worker. The worker takes the job of its next job slot first,
+    // unless it took the slot jobs in a row up to the limit. Then the worker takes the high priority
+    // jobs, then its own jobs in LIFO order, then the jobs of the shared queues. If all are empty, takes
+    // its slot job, or steals the oldest job of an other worker.
+    QueueEntry tryTakeJob(Worker& worker)
+    {
+        if (queuedJobCount == 0u)
+        {
+            return {};
+        }
+
+        if (worker.nextJobRunCount < nextJobSlotLimit)
+        {
+            if (auto entry = takeNextJob(worker); entry.job)
+            {
+                ++worker.nextJobRunCount;
+                return entry;
+            }
+        }
+        worker.nextJobRunCount = 0u;
+        auto entry = tryTakeQueuedJob(worker);
+        if (!entry.job)
+        {
+            entry = takeNextJob(worker);
+            worker.nextJobRunCount = entry.job ? 1u : 0u;
+        }
+        if (!entry.job)
+        {
+            entry = stealJob(worker);
+        }
+        return entry;
+    }
+
+    // Takes the next job of the queues of a worker, and of the shared queues.
+    QueueEntry tryTakeQueuedJob(Worker& worker)
+    {
+        if (schedulingMode == SchedulingMode::WorkStealing)
+        {
+            if (deadlineJobCount > 0u || queuedJobCountByPriority[static_cast<std::size_t>(JobPriority::High)] > 0u)
+            {
+                if (auto entry = tryTakeSharedJob(); entry.job)
+                {
+                    return entry;
+                }
+            }
+
+            GuardLock lock(worker.queueLock);
+            if (!worker.jobs.empty())
+            {
+                return takeBack(worker.jobs);
+            }
+        }
+
+        return tryTakeSharedJob();
+    }
+
+    // Steals a job of an other worker. In work stealing mode, steals the oldest job of the queue of an
+    // other worker first. Then steals the slot job of an other worker, which would wait for its busy
+    // worker otherwise.
+    QueueEntry stealJob(Worker& worker)
+    {
+        if (schedulingMode == SchedulingMode::WorkStealing)
+        {
+            // Steal from the workers of the same NUMA node first.
+            for (auto sameNode : {true, false})
+            {
+                for (std::size_t i = 1u; i < workers.size(); ++i)
+                {
+                    auto& victim = *workers[(worker.index + i) % workers.size()];
+                    if (!victim.isActive || (victim.node == worker.node) != sameNode)
+                    {
+                        continue;
+                    }
+                    GuardLock lock(victim.queueLock);
+                    if (!victim.jobs.empty())
+                    {
+                        worker.stealCount.fetch_add(1u, std::memory_order_relaxed);
+                        return takeFront(victim.jobs);
+                    }
+                }
+            }
+        }
+
+        for (std::size_t i = 1u; i < workers.size(); ++i)
+        {
+            if (auto entry = takeNextJob(*workers[(worker.index + i) % workers.size()]); entry.job)
+            {
+                worker.stealCount.fetch_add(1u, std::memory_order_relaxed);
+                return entry;
+            }
+        }
+
+        return {};
+    }
+
+    // Places the workers on the NUMA nodes and CPUs of the host, by the affinity policy.
+    void placeWorkers()
+    {
+        if (affinityPolicy == AffinityPolicy::None)
+        {
+            return;
+        }
+
+        const auto topology = readCpuTopology();
+        auto nodeOf = [&topology](std::size_t cpu)
+        {
+            for (std::size_t node = 0u; node < topology.size(); ++node)
+            {
+                if (std::find(topology[node].begin(), topology[node].end(), cpu) != topology[node].end())
+                {
+                    return node;
+                }
+            }
+            return std::size_t(0u);
+        };
+        std::vector<std::size_t> compactCpus;
+        for (auto& nodeCpus : topology)
+        {
+            compactCpus.insert(compactCpus.end(), nodeCpus.begin(), nodeCpus.end());
+        }
+
+        for (auto& worker : workers)
+        {
+            const auto index = worker->index;
+            switch (affinityPolicy)
+            {
+                case AffinityPolicy::Compact:
+                {
+                    const auto cpu = compactCpus[index % compactCpus.size()];
+                    worker->node = nodeOf(cpu);
+                    worker->cpus = {cpu};
+                    break;
+                }
+                case AffinityPolicy::Scatter:
+                {
+                    worker->node = index % topology.size();
+                    auto& nodeCpus = topology[worker->node];
+                    worker->cpus = {nodeCpus[(index / topology.size()) % nodeCpus.size()]};
+                    break;
+                }
+                case AffinityPolicy::CpuList:
+                {
+                    const auto cpu = affinityCpus[index % affinityCpus.size()];
+                    worker->node = nodeOf(cpu);
+                    worker->cpus = {cpu};
+                    break;
+                }
+                case AffinityPolicy::NumaNode:
+                {
+                    worker->node = index % topology.size();
+                    worker->cpus = topology[worker->node];
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Returns whether the pool has no queued and no running jobs.
+    bool isDrained() const
+    {
+        return queuedJobCount == 0u && runningJobCount == 0u;
+    }
+
+    // Signals the drain if the pool ran out of jobs.
+    void signalDrained()
+    {
+        if (drainSignalled && isDrained())
+        {
+            // Lock the queue so that the notification does not get lost between the drain checking
+            // its condition and starting to wait.
+            {
+                GuardLock lock(queueLock);
+            }
+            drainCondition.notify_all();
+        }
+    }
+
+    // Parks the worker till there are jobs to run, or the pool gets stopped.
+    void park()
+    {
+        const auto parkedAt = Clock::now();
+        {
+            UniqueLock lock(queueLock);
+            ++parkedThreadCount;
+            auto condition = [this]()
+            {
+                return stopSignalled || queuedJobCount > 0u;
+            };
+            lockCondition.wait(lock, condition);
+            --parkedThreadCount;
+        }
+        recordWakeup(parkedAt);
+    }
+
+    // Parks the worker till there are jobs to run, the pool gets stopped, or the deadline passes.
+    // Returns false if the deadline passed.
+    bool park(Clock::time_point deadline)
+    {
+        const auto parkedAt = Clock::now();
+        bool result = false;
+        {
+            UniqueLock lock(queueLock);
+            ++parkedThreadCount;
+            auto condition = [this]()
+            {
+                return stopSignalled || queuedJobCount > 0u;
+            };
+            result = lockCondition.wait_until(lock, deadline, condition);
+            --parkedThreadCount;
+        }
+        recordWakeup(parkedAt);
+        return result;
+    }
+
+    // Spins, then yields the idle thread before it parks, so that the jobs queued meanwhile start
+    // without the latency of a wake up. Returns whether jobs got queued, or the pool got stopped.
+    bool spinForJobs()
+    {
+        auto hasJobs = [this]()
+        {
+            return stopSignalled || queuedJobCount > 0u;
+        };
+
+        ++spinningThreadCount;
+        auto result = false;
+        for (std::size_t i = 0u; i < spinCount && !result; ++i)
+        {
+            cpuRelax();
+            result = hasJobs();
+        }
+        for (std::size_t i = 0u; i < yieldCount && !result; ++i)
+        {
+            std::this_thread::yield();
+            result = hasJobs();
+        }
+        --spinningThreadCount;
+        return result;
+    }
+
+    // Records the idle time of the worker of the current thread, parked since a time point.
+    void recordWakeup(Clock::time_point parkedAt)
+    {
+        if (auto worker = getCurrentWorker())
+        {
+            const auto idleTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - parkedAt);
+            worker->idleTime.fetch_add(idleTime.count(), std::memory_order_relaxed);
+            worker->wakeupCount.fetch_add(1u, std::memory_order_relaxed);
+        }
+    }
+
+    // Takes the next job for a worker. The job counts as running before it stops counting as queued,
+    // so that the pool does not look idle while the worker holds the job.
+    QueueEntry takeJob(Worker& worker)
+    {
+        if (queuedJobCount == 0u)
+        {
+            return {};
+        }
+        ++runningJobCount;
+        auto entry = tryTakeJob(worker);
+        if (!entry.job)
+        {
+            --runningJobCount;
+            signalDrained();
+        }
+        return entry;
+    }
+
+    // Runs a job on a worker, and completes it. The caller counts the job as running. The worker holds
+    // the running job in its running job slots, so that the pool can stop it. A nested job runs on a
+    // worker which is already busy. Records the queue latency of the job, if the time the job got
+    // queued is known, and its run time.
+    void runJob(Worker& worker, BaseJobPtr job, Clock::time_point queuedAt = {})
+    {
+        const auto startedAt = Clock::now();
+        if (queuedAt != Clock::time_point())
+        {
+            worker.queueLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(startedAt - queuedAt));
+        }
+
+        bool nested = false;
+        {
+            GuardLock lock(worker.queueLock);
+            nested = !worker.runningJobs.empty();
+            worker.runningJobs.push_back(job);
+        }
+
+        if (!stopSignalled)
+        {
+            if (!nested)
+            {
+                --idleThreadCount;
+            }
+            job->schedule();
+            if (!nested)
+            {
+                ++idleThreadCount;
+            }
+        }
+        else
+        {
+            // The stop may have missed the job between taking it and holding it in the running job
+            // slots, cancel the job so that it does not remain queued.
+            job->cancel();
+        }
+
+        {
+            GuardLock lock(worker.queueLock);
+            worker.runningJobs.pop_back();
+        }
+        const auto runTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startedAt);
+        worker.runTime.record(runTime);
+        worker.jobCount.fetch_add(1u, std::memory_order_relaxed);
+        if (!nested)
+        {
+            worker.busyTime.fetch_add(runTime.count(), std::memory_order_relaxed);
+        }
+
+        // Complete the job before it stops counting as running, so that a job which reschedules
+        // itself on completion keeps the pool busy.
+        job->complete();
+        --runningJobCount;
+        signalDrained();
+    }
+
+    // Parks a worker which waits in waitUntil(), till the condition holds, or the pool has queued jobs.
+    void parkWaiting(const std::function<bool()>& condition)
+    {
+        auto& waitingThreads = getWaitingThreads();
+        const auto parkedAt = Clock::now();
+        {
+            UniqueLock lock(waitingThreads.lock);
+            ++waitingThreads.count;
+            // Pairs with the fence of the notifiers, either they see the waiting thread, or the thread
+            // sees their state change.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            waitingThreads.condition.wait(lock, [this, &condition]() { return queuedJobCount > 0u || condition(); });
+            --waitingThreads.count;
+        }
+        recordWakeup(parkedAt);
+    }
+
+    // Runs a queued job on a worker, nested in the job the worker runs. Returns whether there was a
+    // job to run.
+    bool runQueuedJob(Worker& worker)
+    {
+        auto entry = takeJob(worker);
+        if (!entry.job)
+        {
+            return false;
+        }
+        runJob(worker, std::move(entry.job), entry.queuedAt);
+        return true;
+    }
+
+    // Returns whether the pool runs in elastic mode.
+    bool isElastic() const
+    {
+        return maxThreadCount > threadCount;
+    }
+
+    // Starts the thread of a worker.
+    void startWorker(Worker& worker)
+    {
+        worker.isActive = true;
+        ++activeThreadCount;
+        worker.thread = std::thread(&Descriptor::threadMain, &worker);
+    }
+
+    // Starts the thread of an elastic worker which does not run. Returns false if all the workers run.
+    bool spawnWorker()
+    {
+        GuardLock lock(spawnLock);
+        if (stopSignalled)
+        {
+            return false;
+        }
+        for (auto i = threadCount; i < workers.size(); ++i)
+        {
+            auto& worker = *workers[i];
+            if (worker.isActive)
+            {
+                continue;
+            }
+            // Join the thread of the worker if it retired.
+            if (worker.thread.joinable())
+            {
+                worker.thread.join();
+            }
+            startWorker(worker);
+            return true;
+        }
+        return false;
+    }
+
+    // Returns the number of running threads which are not blocked in a blocking scope.
+    std::size_t getUnblockedThreadCount() const
+    {
+        const auto active = activeThreadCount.load();
+        const auto blocked = blockedThreadCount.load();
+        return (active > blocked) ? active - blocked : 0u;
+    }
+
+    // Starts an elastic thread when the oldest job of the shared queues waits longer than the spawn
+    // latency, and there is no idle thread to take it. The blocked threads do not count.
+    void superviseThreads()
+    {
+        if (parkedThreadCount > 0u || queuedJobCount == 0u || getUnblockedThreadCount() >= maxThreadCount)
+        {
+            return;
+        }
+
+        auto oldest = Clock::time_point::max();
+        {
+            GuardLock lock(queueLock);
+            collectInboundJobs();
+            for (auto& queue : jobs)
+            {
+                if (!queue.empty())
+                {
+                    oldest = std::min(oldest, queue.front().queuedAt);
+                }
+            }
+            for (auto& entry : deadlineJobs)
+            {
+                oldest = std::min(oldest, entry.queuedAt);
+            }
+        }
+        if (oldest != Clock::time_point::max() && Clock::now() - oldest >= spawnLatency)
+        {
+            spawnWorker();
+        }
+    }
+
+    // A thread of the pool enters a blocking scope. If there is no idle thread, and the unblocked
+    // threads are fewer than the thread count of the pool, starts a compensating thread.
+    void enterBlockingScope()
+    {
+        ++blockedThreadCount;
+        if (parkedThreadCount > 0u)
+        {
+            wakeOne();
+            return;
+        }
+        if (getUnblockedThreadCount() < threadCount)
+        {
+            spawnWorker();
+        }
+    }
+
+    // A thread of the pool leaves a blocking scope. The surplus threads retire when they idle for the
+    // keep-alive time.
+    void leaveBlockingScope()
+    {
+        --blockedThreadCount;
+    }
+
+    static void threadMain(Worker* worker)
+    {
+        auto& self = worker->pool;
+        currentWorker = worker;
+        pinCurrentThread(worker->cpus);
+        setCurrentThreadPriority(self.threadPriority);
+        // The elastic and the compensating threads retire when they idle.
+        const auto canRetire = worker->index >= self.threadCount;
+
+        // Increase idle thread count before starting the thread loop.
+        ++self.idleThreadCount;
+
+        while (!self.stopSignalled)
+        {
+            auto entry = self.takeJob(*worker);
+            if (!entry.job)
+            {
+                if (self.spinForJobs())
+                {
+                    continue;
+                }
+                if (!canRetire)
+                {
+                    self.park();
+                }
+                else if (!self.park(Clock::now() + self.keepAlive))
+                {
+                    // The worker idled for the keep-alive time, retire.
+                    break;
+                }
+                continue;
+            }
+            // The wake ups got skipped while the thread spun, pass them on to a parked thread.
+            if (self.queuedJobCount > 0u)
+            {
+                self.wakeOne();
+            }
+            self.runJob(*worker, std::move(entry.job), entry.queuedAt);
+        }
+
+        // Decrease idle thread count before exiting the thread loop.
+        --self.idleThreadCount;
+        --self.activeThreadCount;
+        self.releaseTaskSlots(*worker);
+        worker->isActive = false;
+        currentWorker = nullptr;
+    }
+
+    // Adds a timed job, and starts the timer thread if not yet started.
+    bool addTimer(JobPtr job, Clock::time_point dueTime, std::chrono::nanoseconds period)
+    {
+        abortIfFail(job);
+        if (stopSignalled || job->isStopped())
+        {
+            return false;
+        }
+
+        {
+            GuardLock lock(timerLock);
+            startTimerThread();
+            timers.push_back({std::move(job), dueTime, period});
+            std::push_heap(timers.begin(), timers.end());
+        }
+        timerCondition.notify_one();
+        return true;
+    }
+
+    // Starts the timer thread, if not yet started. Call it with the timers locked.
+    void startTimerThread()
+    {
+        if (!timerThread.joinable())
+        {
+            timerThread = std::thread(&Descriptor::timerMain, &owner);
+        }
+    }
+
+    // The timer thread queues the timed jobs when they are due, and re-arms the periodic ones. In
+    // elastic mode, the timer thread also supervises the threads of the pool.
+    static void timerMain(ThreadPool* self)
+    {
+        auto& d = *self->descriptor;
+        auto supervisionTime = Clock::now();
+        UniqueLock lock(d.timerLock);
+        while (!d.stopSignalled)
+        {
+            const auto now = Clock::now();
+            if (d.isElastic() && now >= supervisionTime)
+            {
+                lock.unlock();
+                d.superviseThreads();
+                lock.lock();
+                supervisionTime = now + d.spawnLatency;
+                continue;
+            }
+
+            if (d.timers.empty() && !d.isElastic())
+            {
+                d.timerCondition.wait(lock, [&d]() { return d.stopSignalled || !d.timers.empty(); });
+                continue;
+            }
+
+            auto wakeTime = d.isElastic() ? supervisionTime : Clock::time_point::max();
+            if (!d.timers.empty())
+            {
+                wakeTime = std::min(wakeTime, d.timers.front().dueTime);
+            }
+            if (now < wakeTime)
+            {
+                d.timerCondition.wait_until(lock, wakeTime);
+                continue;
+            }
+
+            std::pop_heap(d.timers.begin(), d.timers.end());
+            auto entry = std::move(d.timers.back());
+            d.timers.pop_back();
+
+            // Stopped jobs are cancelled.
+            if (entry.job->isStopped())
+            {
+                continue;
+            }
+
+            lock.unlock();
+            const auto scheduled = d.scheduleTask(entry.job, false);
+            lock.lock();
+
+            if (entry.job->isStopped())
+            {
+                continue;
+            }
+            if (d.stopSignalled)
+            {
+                // The stop of the timers missed the entry taken off the heap. Stop the job which did
+                // not get queued, so that it settles.
+                if (!scheduled)
+                {
+                    lock.unlock();
+                    entry.job->stop();
+                    lock.lock();
+                }
+                continue;
+            }
+            if (entry.period.count() > 0)
+            {
+                // Skip the missed periods.
+                const auto now = Clock::now();
+                while (entry.dueTime <= now)
+                {
+                    entry.dueTime += entry.period;
+                }
+            }
+            else if (!scheduled)
+            {
+                // The job is busy, or the shared queues are full. Retry to queue it later.
+                entry.dueTime = Clock::now() + TimerRetryDelay;
+            }
+            else
+            {
+                continue;
+            }
+            d.timers.push_back(std::move(entry));
+            std::push_heap(d.timers.begin(), d.timers.end());
+        }
+    }
+
+    // Stops the timer thread and the timed jobs. The jobs get stopped after the timers are unlocked, as
+    // stopping a job runs the code of the job.
+    void stopTimers()
+    {
+        std::vector<TimerEntry> stoppedTimers;
+        {
+            GuardLock lock(timerLock);
+            stoppedTimers.swap(timers);
+        }
+        for (auto& entry : stoppedTimers)
+        {
+            if (!entry.job->isStopped())
+            {
+                entry.job->stop();
+            }
+        }
+        timerCondition.notify_all();
+        if (timerThread.joinable())
+        {
+            timerThread.join();
+        }
+    }
+
+    // Takes the jobs of a queue to cancel.
+    void takeJobs(std::deque<QueueEntry>& queue, std::vector<BaseJobPtr>& cancelledJobs)
+    {
+        for (auto& entry : queue)
+        {
+            cancelledJobs.push_back(std::move(entry.job));
+        }
+        queue.clear();
+    }
+
+    // Takes the queued jobs of the shared queues and of the worker queues to cancel. Call it with the
+    // queue locked, and cancel the jobs after unlocking the queue, as cancelling a job may run the code
+    // of the job, for example resume a coroutine.
+    void takeQueuedJobs(std::vector<BaseJobPtr>& cancelledJobs)
+    {
+        collectInboundJobs();
+        for (auto& entry : deadlineJobs)
+        {
+            cancelledJobs.push_back(std::move(entry.job));
+            removeQueuedJobs(entry.priority, 1u);
+        }
+        deadlineJobCount -= deadlineJobs.size();
+        releasePlaces(deadlineJobs.size());
+        deadlineJobs.clear();
+
+        for (std::size_t priority = 0u; priority < PriorityCount; ++priority)
+        {
+            const auto count = jobs[priority].size();
+            removeQueuedJobs(static_cast<JobPriority>(priority), count);
+            lockedJobCount -= count;
+            releasePlaces(count);
+            takeJobs(jobs[priority], cancelledJobs);
+        }
+        for (auto& worker : workers)
+        {
+            GuardLock workerLock(worker->queueLock);
+            removeQueuedJobs(JobPriority::Normal, worker->jobs.size());
+            takeJobs(worker->jobs, cancelledJobs);
+            if (worker->nextJob.job)
+            {
+                cancelledJobs.push_back(std::exchange(worker->nextJob, {}).job);
+                worker->hasNextJob = false;
+                removeQueuedJobs(JobPriority::Normal, 1u);
+            }
+        }
+    }
+
+    // Cancels the jobs taken from the queues.
+    static void cancelJobs(const std::vector<BaseJobPtr>& cancelledJobs)
+    {
+        for (auto& job : cancelledJobs)
+        {
+            job->cancel();
+        }
+    }
+
+    // Stops the jobs pushed by a submitter which raced with the stop of the pool. The stop may have
+    // swept the queues before the submitter pushed its jobs.
+    void stopLateJobs()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (stopSignalled)
+        {
+            std::vector<BaseJobPtr> cancelledJobs;
+            {
+                GuardLock lock(queueLock);
+                takeQueuedJobs(cancelledJobs);
+            }
+            cancelJobs(cancelledJobs);
+        }
+    }
+};
+
+thread_local ThreadPool::Descriptor::Worker* ThreadPool::Descriptor::currentWorker = nullptr;
+
+
+std::chrono::nanoseconds ThreadPool::Histogram::getMean() const
+{
+    return count > 0u ? total / static_cast<std::int64_t>(count) : std::chrono::nanoseconds::zero();
+}
+
+std::chrono::nanoseconds ThreadPool::Histogram::getPercentile(double percentile) const
+{
+    if (count == 0u)
     {
+        return std::chrono::nanoseconds::zero();
     }
 
-    // Pop the job from the queue and put it into the list of scheduled jobs.
-    BaseJobPtr scheduleNextJob()
+    const auto rank = static_cast<std::size_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(count)));
+    std::size_t accumulated = 0u;
+    for (std::size_t bucket = 0u; bucket < BucketCount - 1u; ++bucket)
     {
-        UniqueLock lock(queueLock);
-        auto condition = [this]()
-        {
-            return stopSignalled || !jobs.empty();
-        };
-        lockCondition.wait(lock, condition);
-
-        if (jobs.empty())
+        accumulated += buckets[bucket];
+        if (accumulated >= std::max<std::size_t>(rank, 1u))
         {
-            return {};
+            // The upper limit of the bucket, which never exceeds the longest duration.
+            const auto limit = bucket == 0u ? std::int64_t(0) : (std::int64_t(1) << bucket) - 1;
+            return std::min(std::chrono::nanoseconds(limit), max);
         }
-
-        auto job = jobs.front();
-        jobs.pop_front();
-        scheduledJobs.push_back(job);
-        return job;
     }
+    return max;
+}
 
-    static void threadMain(ThreadPool* self)
-    {
-        // Increase idle thread count before starting the thread loop.
-        ++self->descriptor->idleThreadCount;
 
-        while (!self->descriptor->stopSignalled)
-        {
-            self->runNextJob();
-        }
+ThreadPool::ThreadPool(std::size_t threadCount) :
+    descriptor(std::make_unique<ThreadPool::Descriptor>(*this, threadCount))
+{
+}
 
-        // Decrease idle thread count before exiting the thread loop.
-        --self->descriptor->idleThreadCount;
-    }
-};
+ThreadPool::~ThreadPool()
+{
+    abortIfFail(!descriptor->isRunning);
+}
 
+void ThreadPool::setSchedulingMode(SchedulingMode mode)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->schedulingMode = mode;
+}
 
-ThreadPool::ThreadPool(std::size_t threadCount) :
-    descriptor(std::make_unique<ThreadPool::Descriptor>(threadCount))
+ThreadPool::SchedulingMode ThreadPool::getSchedulingMode() const
 {
+    return descriptor->schedulingMode;
 }
 
-ThreadPool::~ThreadPool()
+void ThreadPool::setAffinityPolicy(AffinityPolicy policy, std::vector<std::size_t> cpus)
 {
     abortIfFail(!descriptor->isRunning);
+    abortIfFail(policy != AffinityPolicy::CpuList || !cpus.empty());
+    descriptor->affinityPolicy = policy;
+    descriptor->affinityCpus = std::move(cpus);
 }
 
-void ThreadPool::runNextJob()
+ThreadPool::AffinityPolicy ThreadPool::getAffinityPolicy() const
 {
-    auto currentJob = descriptor->scheduleNextJob();
-    if (!descriptor->stopSignalled)
-    {
-        --descriptor->idleThreadCount;
-        currentJob->schedule();
-        ++descriptor->idleThreadCount;
-    }
+    return descriptor->affinityPolicy;
+}
 
-    if (!currentJob)
-    {
-        return;
-    }
+void ThreadPool::setThreadPriority(JobPriority priority)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->threadPriority = priority;
+}
 
-    {
-        GuardLock lock(descriptor->queueLock);
-        std::erase(descriptor->scheduledJobs, currentJob);
-    }
-    currentJob->complete();
+JobPriority ThreadPool::getThreadPriority() const
+{
+    return descriptor->threadPriority;
+}
+
+void ThreadPool::setQueueCapacity(std::size_t capacity)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->queueCapacity = capacity;
+}
+
+std::size_t ThreadPool::getQueueCapacity() const
+{
+    return descriptor->queueCapacity;
+}
+
+void ThreadPool::setOverflowPolicy(OverflowPolicy policy)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->overflowPolicy = policy;
+}
+
+ThreadPool::OverflowPolicy ThreadPool::getOverflowPolicy() const
+{
+    return descriptor->overflowPolicy;
+}
+
+void ThreadPool::setBlockTimeout(const std::chrono::nanoseconds& timeout)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->blockTimeout = timeout;
+}
+
+std::chrono::nanoseconds ThreadPool::getBlockTimeout() const
+{
+    return descriptor->blockTimeout;
+}
+
+void ThreadPool::setIdleSpinning(std::size_t spinCount, std::size_t yieldCount)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->spinCount = spinCount;
+    descriptor->yieldCount = yieldCount;
+}
+
+std::size_t ThreadPool::getIdleSpinCount() const
+{
+    return descriptor->spinCount;
+}
+
+std::size_t ThreadPool::getIdleYieldCount() const
+{
+    return descriptor->yieldCount;
+}
+
+std::size_t ThreadPool::getOverflowCount(OverflowPolicy policy) const
+{
+    return descriptor->overflowCounts[static_cast<std::size_t>(policy)];
+}
+
+void ThreadPool::setNextJobSlotLimit(std::size_t limit)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->nextJobSlotLimit = limit;
+}
+
+std::size_t ThreadPool::getNextJobSlotLimit() const
+{
+    return descriptor->nextJobSlotLimit;
+}
+
+void ThreadPool::setMissedDeadlinePolicy(MissedDeadlinePolicy policy)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->missedDeadlinePolicy = policy;
+}
+
+ThreadPool::MissedDeadlinePolicy ThreadPool::getMissedDeadlinePolicy() const
+{
+    return descriptor->missedDeadlinePolicy;
+}
+
+std::size_t ThreadPool::getMissedDeadlineCount() const
+{
+    return descriptor->missedDeadlineCount;
+}
+
+void ThreadPool::setMaxThreadCount(std::size_t maxThreadCount)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->maxThreadCount = maxThreadCount;
+}
+
+std::size_t ThreadPool::getMaxThreadCount() const
+{
+    return std::max(descriptor->threadCount, descriptor->maxThreadCount);
+}
+
+void ThreadPool::setMaxCompensatingThreadCount(std::size_t count)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->maxCompensatingThreadCount = count;
+}
+
+std::size_t ThreadPool::getMaxCompensatingThreadCount() const
+{
+    return descriptor->maxCompensatingThreadCount;
+}
+
+void ThreadPool::setSpawnLatency(const std::chrono::nanoseconds& latency)
+{
+    abortIfFail(!descriptor->isRunning);
+    abortIfFail(latency.count() > 0);
+    descriptor->spawnLatency = latency;
+}
+
+std::chrono::nanoseconds ThreadPool::getSpawnLatency() const
+{
+    return descriptor->spawnLatency;
+}
+
+void ThreadPool::setKeepAlive(const std::chrono::nanoseconds& keepAlive)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->keepAlive = keepAlive;
+}
+
+std::chrono::nanoseconds ThreadPool::getKeepAlive() const
+{
+    return descriptor->keepAlive;
+}
+
+void ThreadPool::setPriorityAging(const std::chrono::nanoseconds& aging)
+{
+    abortIfFail(!descriptor->isRunning);
+    descriptor->priorityAging = aging;
+}
+
+std::chrono::nanoseconds ThreadPool::getPriorityAging() const
+{
+    return descriptor->priorityAging;
 }
 
 void ThreadPool::start()
 {
     abortIfFail(!descriptor->isRunning);
     descriptor->stopSignalled = false;
+    descriptor->drainSignalled = false;
     descriptor->idleThreadCount = 0u;
 
-    descriptor->threads.reserve(descriptor->threadCount);
+    descriptor->activeThreadCount = 0u;
+
+    // Create all the workers before starting the threads, so that the threads can steal from each other.
+    // The workers of the elastic and the compensating threads are created upfront, and their threads
+    // start on demand.
+    const auto workerCount = std::max(descriptor->threadCount, descriptor->maxThreadCount) + descriptor->maxCompensatingThreadCount;
+    {
+        // The metrics read the workers under the queue lock.
+        GuardLock lock(descriptor->queueLock);
+        descriptor->workers.reserve(workerCount);
+        for (std::size_t i = 0u; i < workerCount; ++i)
+        {
+            descriptor->workers.push_back(std::make_unique<Descriptor::Worker>(*descriptor, i));
+        }
+    }
+    descriptor->placeWorkers();
     for (std::size_t i = 0u; i < descriptor->threadCount; ++i)
     {
-        descriptor->threads.push_back(std::thread(&Descriptor::threadMain, this));
+        descriptor->startWorker(*descriptor->workers[i]);
+    }
+    if (descriptor->isElastic())
+    {
+        GuardLock lock(descriptor->timerLock);
+        descriptor->startTimerThread();
     }
     descriptor->isRunning = true;
 }
@@ -143,55 +2110,75 @@ void ThreadPool::stop()
 {
     abortIfFail(descriptor->isRunning);
 
-    // Signal stop call.
+    // Signal stop call. Wait for a thread being started, no threads start after the stop signal.
     descriptor->stopSignalled = true;
+    // Pairs with the fence of the submitters, either the stop sees their jobs, or they see the stop.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+        GuardLock lock(descriptor->spawnLock);
+    }
+    descriptor->stopTimers();
+    std::vector<BaseJobPtr> cancelledJobs;
     {
         GuardLock lock(descriptor->queueLock);
+        descriptor->spaceCondition.notify_all();
 
-        // Stop the queued jobs first.
-        for (auto& job : descriptor->jobs)
+        // Stop the queued jobs first, then the running jobs. The jobs get cancelled after the queues
+        // are unlocked.
+        descriptor->takeQueuedJobs(cancelledJobs);
+        for (auto& worker : descriptor->workers)
         {
-            std::dynamic_pointer_cast<Job>(job)->stop();
+            GuardLock workerLock(worker->queueLock);
+            cancelledJobs.insert(cancelledJobs.end(), worker->runningJobs.begin(), worker->runningJobs.end());
         }
-        descriptor->jobs.clear();
+    }
+    Descriptor::cancelJobs(cancelledJobs);
+    cancelledJobs.clear();
+
+    // Notify all the threads to stop executing their jobs. The threads exit when their running jobs
+    // return, join them.
+    descriptor->lockCondition.notify_all();
 
-        // Then stop the scheduled jobs.
-        for (auto& job : descriptor->scheduledJobs)
+    for (auto& worker : descriptor->workers)
+    {
+        if (worker->thread.joinable())
         {
-            std::dynamic_pointer_cast<Job>(job)->stop();
+            worker->thread.join();
         }
-        descriptor->scheduledJobs.clear();
     }
 
-    // Notify all the threads to stop executing their jobs.
-    descriptor->lockCondition.notify_all();
-    schedule();
-
-    // Wait till threads complete the tasks.
-    while (descriptor->idleThreadCount > 0u)
+    // The threads may have queued jobs before they exited, stop those too.
     {
-        schedule(std::chrono::milliseconds(10));
+        GuardLock lock(descriptor->queueLock);
+        descriptor->takeQueuedJobs(cancelledJobs);
+        descriptor->workers.clear();
     }
+    Descriptor::cancelJobs(cancelledJobs);
+    descriptor->isRunning = false;
+}
+
+bool ThreadPool::drain(Clock::time_point deadline)
+{
+    abortIfFail(descriptor->isRunning);
+    // A thread of the pool would wait for its own job.
+    abortIfFail(!descriptor->getCurrentWorker());
 
-    // Join the threads.
-    for (auto& thread : descriptor->threads)
+    descriptor->drainSignalled = true;
+    auto drained = false;
     {
-        if (thread.joinable())
-        {
-            thread.join();
-        }
+        UniqueLock lock(descriptor->queueLock);
+        drained = descriptor->drainCondition.wait_until(lock, deadline, [this]() { return descriptor->isDrained(); });
     }
 
-    descriptor->threads.clear();
-    descriptor->isRunning = false;
+    stop();
+    return drained;
 }
 
 bool ThreadPool::isBusy()
 {
-    UniqueLock lock(descriptor->queueLock);
-    return !descriptor->jobs.empty() ||
-           !descriptor->scheduledJobs.empty() ||
-           descriptor->idleThreadCount < descriptor->threadCount;
+    return descriptor->queuedJobCount > 0u ||
+           descriptor->runningJobCount > 0u ||
+           descriptor->idleThreadCount < descriptor->activeThreadCount;
 }
 
 bool ThreadPool::isRunning() const
@@ -206,7 +2193,7 @@ bool ThreadPool::isStopSignalled() const
 
 std::size_t ThreadPool::getThreadCount() const
 {
-    return descriptor->isRunning ? descriptor->threadCount : 0u;
+    return descriptor->isRunning ? descriptor->activeThreadCount.load() : 0u;
 }
 
 std::size_t ThreadPool::getIdleCount() const
@@ -215,31 +2202,49 @@ std::size_t ThreadPool::getIdleCount() const
 }
 
 bool ThreadPool::tryScheduleJob(JobPtr job)
+{
+    return tryScheduleTask(std::move(job));
+}
+
+void* ThreadPool::allocateTaskSlot()
+{
+    return descriptor->allocateTaskSlot();
+}
+
+void ThreadPool::deallocateTaskSlot(void* slot)
+{
+    descriptor->deallocateTaskSlot(slot);
+}
+
+bool ThreadPool::tryScheduleTask(BaseJobPtr task)
+{
+    return descriptor->scheduleTask(std::move(task), true);
+}
+
+std::size_t ThreadPool::tryScheduleJobs(std::span<const JobPtr> jobs)
 {
     if (descriptor->stopSignalled)
     {
-        return false;
+        return 0u;
     }
 
-    abortIfFail(job);    
-
+    abortIfFail(!jobs.empty());
+    if (descriptor->queueCapacity > 0u)
     {
-        GuardLock lock(descriptor->queueLock);
-        auto baseJob = static_cast<BaseJob*>(job.get());
-        if (!baseJob->canQueue())
-        {
-            return false;
-        }
-        descriptor->jobs.push_back(job);
-        baseJob->queue();
+        // A bounded pool admits the jobs one by one.
+        return static_cast<std::size_t>(std::count_if(jobs.begin(), jobs.end(), [this](auto& job) { return tryScheduleTask(job); }));
     }
-
-    descriptor->lockCondition.notify_one();
-
-    return true;
+    auto copy = [](const JobPtr& job) -> BaseJobPtr
+    {
+        return job;
+    };
+    const auto result = descriptor->pushJobs(jobs, copy);
+    descriptor->stopLateJobs();
+    descriptor->wakeWorkers(result);
+    return result;
 }
 
-std::size_t ThreadPool::tryScheduleJobs(std::vector<JobPtr> jobs)
+std::size_t ThreadPool::tryScheduleJobs(std::vector<JobPtr>&& jobs)
 {
     if (descriptor->stopSignalled)
     {
@@ -247,55 +2252,173 @@ std::size_t ThreadPool::tryScheduleJobs(std::vector<JobPtr> jobs)
     }
 
     abortIfFail(!jobs.empty());
-    std::size_t result = 0u;
-
+    if (descriptor->queueCapacity > 0u)
     {
-        GuardLock lock(descriptor->queueLock);
-
+        // A bounded pool admits the jobs one by one.
+        std::size_t result = 0u;
         for (auto& job : jobs)
         {
-            auto baseJob = static_cast<BaseJob*>(job.get());
-            if (!baseJob->canQueue())
+            if (tryScheduleTask(job))
             {
-                continue;
+                job.reset();
+                ++result;
             }
-            descriptor->jobs.push_back(job);
-            baseJob->queue();
-            ++result;
         }
+        return result;
     }
+    auto move = [](JobPtr& job) -> BaseJobPtr
+    {
+        return std::move(job);
+    };
+    const auto result = descriptor->pushJobs(std::span<JobPtr>(jobs), move);
+    descriptor->stopLateJobs();
+    descriptor->wakeWorkers(result);
+    return result;
+}
+
+bool ThreadPool::scheduleAfter(JobPtr job, const std::chrono::nanoseconds& delay)
+{
+    return descriptor->addTimer(std::move(job), Clock::now() + delay, std::chrono::nanoseconds::zero());
+}
+
+bool ThreadPool::scheduleAt(JobPtr job, Clock::time_point timePoint)
+{
+    return descriptor->addTimer(std::move(job), timePoint, std::chrono::nanoseconds::zero());
+}
+
+bool ThreadPool::schedulePeriodic(JobPtr job, const std::chrono::nanoseconds& period)
+{
+    abortIfFail(period.count() > 0);
+    return descriptor->addTimer(std::move(job), Clock::now() + period, period);
+}
+
+std::size_t ThreadPool::getQueuedJobs() const
+{
+    return descriptor->queuedJobCount;
+}
 
-    if (jobs.size() > 1)
+ThreadPool::Metrics ThreadPool::getMetrics() const
+{
+    Metrics metrics;
+    metrics.queuedJobs = descriptor->queuedJobCount;
+    metrics.runningJobs = descriptor->runningJobCount;
+    metrics.threadCount = getThreadCount();
+    metrics.idleCount = descriptor->idleThreadCount;
+    // Read the workers under the queue lock, as the stop of the pool destroys them under the lock.
+    GuardLock lock(descriptor->queueLock);
+    if (!descriptor->isRunning)
     {
-        descriptor->lockCondition.notify_all();
+        return metrics;
     }
-    else
+
+    metrics.workers.reserve(descriptor->workers.size());
+    for (auto& worker : descriptor->workers)
     {
-        descriptor->lockCondition.notify_one();
-    }
+        worker->queueLatency.addTo(metrics.queueLatency);
+        worker->runTime.addTo(metrics.runTime);
 
-    return result;
+        auto& workerMetrics = metrics.workers.emplace_back();
+        workerMetrics.busyTime = std::chrono::nanoseconds(worker->busyTime.load(std::memory_order_relaxed));
+        workerMetrics.idleTime = std::chrono::nanoseconds(worker->idleTime.load(std::memory_order_relaxed));
+        workerMetrics.jobCount = worker->jobCount.load(std::memory_order_relaxed);
+        workerMetrics.stealCount = worker->stealCount.load(std::memory_order_relaxed);
+        workerMetrics.wakeupCount = worker->wakeupCount.load(std::memory_order_relaxed);
+        workerMetrics.isActive = worker->isActive;
+    }
+    return metrics;
 }
 
-std::size_t ThreadPool::getQueuedJobs() const
+std::size_t ThreadPool::getQueuedJobs(JobPriority priority) const
 {
-    return descriptor->jobs.size();
+    return descriptor->queuedJobCountByPriority[static_cast<std::size_t>(priority)];
 }
 
 void ThreadPool::schedule()
 {
-    schedule(std::chrono::nanoseconds(1));
+    auto worker = descriptor->getCurrentWorker();
+    if (!worker)
+    {
+        schedule(std::chrono::nanoseconds(1));
+        return;
+    }
+    if (!descriptor->runQueuedJob(*worker))
+    {
+        std::this_thread::yield();
+    }
 }
 
 void ThreadPool::schedule(const std::chrono::nanoseconds& delay)
 {
-    std::this_thread::sleep_for(delay);
+    auto worker = descriptor->getCurrentWorker();
+    if (!worker)
+    {
+        std::this_thread::sleep_for(delay);
+        return;
+    }
+
+    // Run the queued jobs till the delay elapses. When there are no jobs to run, park till a job
+    // gets queued.
+    const auto deadline = Clock::now() + delay;
+    do
+    {
+        if (!descriptor->runQueuedJob(*worker))
+        {
+            descriptor->park(deadline);
+        }
+    } while (!descriptor->stopSignalled && Clock::now() < deadline);
+}
+
+void ThreadPool::waitUntil(const std::function<bool()>& condition)
+{
+    auto worker = descriptor->getCurrentWorker();
+    abortIfFail(worker);
+    while (!condition())
+    {
+        if (!descriptor->runQueuedJob(*worker))
+        {
+            descriptor->parkWaiting(condition);
+        }
+    }
+}
+
+void ThreadPool::notifyWaiters()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    getWaitingThreads().wake();
+}
+
+ThreadPool* ThreadPool::getCurrent()
+{
+    auto worker = Descriptor::currentWorker;
+    return worker ? &worker->pool.owner : nullptr;
+}
+
+
+BlockingScope::BlockingScope() :
+    m_pool(ThreadPool::getCurrent())
+{
+    if (m_pool)
+    {
+        m_pool->descriptor->enterBlockingScope();
+    }
+}
+
+BlockingScope::~BlockingScope()
+{
+    if (m_pool)
+    {
+        m_pool->descriptor->leaveBlockingScope();
+    }
 }
 
 
 bool async(JobPtr job)
 {
-    auto pool = Library::instance().threadPool();
+    return async(Library::instance().threadPool(), std::move(job));
+}
+
+bool async(ThreadPool* pool, JobPtr job)
+{
     if (pool)
     {
         return pool->tryScheduleJob(job);
@@ -304,16 +2427,32 @@ bool async(JobPtr job)
     {
         auto baseJob = static_cast<ThreadPool::BaseJob*>(job.get());
 
-        baseJob->queue();
+        if (!baseJob->tryQueue())
+        {
+            return false;
+        }
         baseJob->schedule();
         baseJob->complete();
         return true;
     }
 }
 
+bool async(std::string_view executor, JobPtr job)
+{
+    if (!Library::instance().hasExecutor(executor))
+    {
+        return false;
+    }
+    return async(Library::instance().executor(executor), std::move(job));
+}
+
 void yield()
 {
-    auto pool = Library::instance().threadPool();
+    auto pool = ThreadPool::getCurrent();
+    if (!pool)
+    {
+        pool = Library::instance().threadPool();
+    }
     if (pool)
     {
         pool->schedule();
@@ -322,7 +2461,11 @@ void yield()
 
 void yield(const std::chrono::nanoseconds& delay)
 {
-    auto pool = Library::instance().threadPool();
+    auto pool = ThreadPool::getCurrent();
+    if (!pool)
+    {
+        pool = Library::instance().threadPool();
+    }
     if (pool)
     {
         pool->schedule(delay);
@@ -32,6 +32,7 @@
 
 #include <stew/log/trace.hpp>
 
+#include <algorithm>
 #include <memory>
 
 namespace stew
@@ -54,6 +55,7 @@ public:
     }
 
     std::unique_ptr<ThreadPool> threadPool;
+    std::vector<std::pair<std::string, std::unique_ptr<ThreadPool>>> executors;
     std::shared_ptr<Tracer> tracer;
     std::unique_ptr<ObjectFactory> objectFactory;
 };
@@ -80,11 +82,53 @@ void Library::initialize(const LibraryArguments& arguments)
     if (arguments.threadPool.createThreadPool)
     {
         d->threadPool = std::make_unique<ThreadPool>(arguments.threadPool.threadCount);
+        d->threadPool->setSchedulingMode(arguments.threadPool.schedulingMode);
+        d->threadPool->setPriorityAging(arguments.threadPool.priorityAging);
+        d->threadPool->setMaxThreadCount(arguments.threadPool.maxThreadCount);
+        d->threadPool->setSpawnLatency(arguments.threadPool.spawnLatency);
+        d->threadPool->setKeepAlive(arguments.threadPool.keepAlive);
+        d->threadPool->setMaxCompensatingThreadCount(arguments.threadPool.maxCompensatingThreadCount);
+        d->threadPool->setAffinityPolicy(arguments.threadPool.affinityPolicy, arguments.threadPool.affinityCpus);
+        d->threadPool->setQueueCapacity(arguments.threadPool.queueCapacity);
+        d->threadPool->setOverflowPolicy(arguments.threadPool.overflowPolicy);
+        d->threadPool->setBlockTimeout(arguments.threadPool.blockTimeout);
+        d->threadPool->setIdleSpinning(arguments.threadPool.idleSpinCount, arguments.threadPool.idleYieldCount);
+        d->threadPool->setMissedDeadlinePolicy(arguments.threadPool.missedDeadlinePolicy);
+        d->threadPool->setNextJobSlotLimit(arguments.threadPool.nextJobSlotLimit);
+        d->threadPool->setThreadPriority(arguments.threadPool.threadPriority);
         d->threadPool->start();
     }
 
+    auto executors = arguments.executors;
 #ifdef CONFIG_ENABLE_LOGS
-    d->tracer = std::make_unique<Tracer>(d->threadPool.get());
+    // Flushing the logs must not take the threads of the other jobs.
+    auto isTracerExecutor = [&arguments](auto& executor) { return executor.name == arguments.tracer.executor; };
+    if (!arguments.tracer.executor.empty() && std::none_of(executors.begin(), executors.end(), isTracerExecutor))
+    {
+        auto& tracerExecutor = executors.emplace_back();
+        tracerExecutor.name = arguments.tracer.executor;
+        tracerExecutor.threadPriority = JobPriority::Background;
+    }
+#endif
+    for (auto& executor : executors)
+    {
+        abortIfFail(!executor.name.empty() && !hasExecutor(executor.name));
+        // Without the thread pool of the library, the executors run their jobs on the calling thread.
+        std::unique_ptr<ThreadPool> pool;
+        if (arguments.threadPool.createThreadPool)
+        {
+            pool = std::make_unique<ThreadPool>(executor.threadCount);
+            pool->setSchedulingMode(executor.schedulingMode);
+            pool->setAffinityPolicy(executor.affinityPolicy, executor.affinityCpus);
+            pool->setThreadPriority(executor.threadPriority);
+            pool->start();
+        }
+        d->executors.emplace_back(executor.name, std::move(pool));
+    }
+
+#ifdef CONFIG_ENABLE_LOGS
+    auto tracerPool = executor(arguments.tracer.executor);
+    d->tracer = std::make_unique<Tracer>(tracerPool ? tracerPool : d->threadPool.get());
     d->tracer->setLogLevel(arguments.tracer.logLevel);
 
     TracePrinterPtr printer = std::make_shared<ConsoleOut>();
@@ -108,6 +152,13 @@ void Library::uninitialize()
     {
         d->threadPool->stop();
     }
+    for (auto& executor : d->executors)
+    {
+        if (executor.second)
+        {
+            executor.second->stop();
+        }
+    }
 
     d->objectFactory.reset();
     if (d->tracer && d->tracer->isBusy())
@@ -116,6 +167,7 @@ void Library::uninitialize()
         d->tracer->wait();
     }
     d->tracer.reset();
+    d->executors.clear();
     d->threadPool.reset();
 }
 
@@ -125,6 +177,19 @@ ThreadPool* Library::threadPool() const
     return d->threadPool.get();
 }
 
+ThreadPool* Library::executor(std::string_view name) const
+{
+    D();
+    auto it = std::find_if(d->executors.begin(), d->executors.end(), [name](auto& executor) { return executor.first == name; });
+    return (it != d->executors.end()) ? it->second.get() : nullptr;
+}
+
+bool Library::hasExecutor(std::string_view name) const
+{
+    D();
+    return std::any_of(d->executors.begin(), d->executors.end(), [name](auto& executor) { return executor.first == name; });
+}
+
 Tracer* Library::tracer() const
 {
     D();
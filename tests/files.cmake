@@ -1,13 +1,20 @@
 set(SOURCES
 test_argument_type.cpp
+test_coroutine.cpp
+test_future.cpp
 test_guarded_sequence_container.cpp
 test_invokable.cpp
+test_job_graph.cpp
+test_job_group.cpp
 test_log.cpp
 test_lru_cache.cpp
 test_main.cpp
 test_meta_class.cpp
 test_object.cpp
 test_object_extension.cpp
+test_parallel.cpp
+test_pipeline.cpp
+test_serial_executor.cpp
 test_signal_slot.cpp
 test_thread_pool.cpp
 test_log_fixtures.hpp
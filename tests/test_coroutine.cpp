@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/coroutine.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+class CoroutineTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+};
+
+class GateJob : public stew::Job
+{
+public:
+    std::atomic_bool open = false;
+
+protected:
+    void run() override
+    {
+        while (!open)
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+
+stew::Future<int> returnValue(int value)
+{
+    co_return value;
+}
+
+stew::Future<void> throwError()
+{
+    throw std::runtime_error("coroutine");
+    co_return;
+}
+
+stew::Future<stew::ThreadPool*> hopToPool(stew::ThreadPool* pool)
+{
+    co_await stew::resumeOn(pool);
+    co_return stew::ThreadPool::getCurrent();
+}
+
+stew::Future<stew::Job::Status> awaitJob(stew::JobPtr job)
+{
+    auto status = co_await job;
+    co_return status;
+}
+
+stew::Future<std::chrono::nanoseconds> awaitDelay(std::chrono::nanoseconds duration)
+{
+    const auto start = std::chrono::steady_clock::now();
+    co_await stew::delay(duration);
+    co_return std::chrono::steady_clock::now() - start;
+}
+
+stew::Future<int> awaitFutures()
+{
+    auto first = co_await returnValue(1);
+    auto second = co_await stew::async([]() { return 2; });
+    co_return first + second;
+}
+
+}
+
+INSTANTIATE_TEST_SUITE_P(CoroutineTests, CoroutineTest, ::testing::Values(true, false));
+
+TEST_P(CoroutineTest, coroutineReturnsValue)
+{
+    auto future = returnValue(42);
+    EXPECT_TRUE(future.isReady());
+    EXPECT_EQ(42, future.get());
+}
+
+TEST_P(CoroutineTest, coroutineStoresException)
+{
+    auto future = throwError();
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST_P(CoroutineTest, resumeOnThreadPool)
+{
+    auto pool = stew::Library::instance().threadPool();
+    auto future = hopToPool(nullptr);
+    EXPECT_EQ(pool, future.get());
+}
+
+TEST_P(CoroutineTest, awaitJob)
+{
+    auto pool = stew::Library::instance().threadPool();
+    if (!pool)
+    {
+        GTEST_SKIP() << "The job awaiter needs a thread pool.";
+    }
+    auto job = std::make_shared<GateJob>();
+    ASSERT_TRUE(pool->tryScheduleJob(job));
+
+    auto future = awaitJob(job);
+    EXPECT_FALSE(future.isReady());
+    job->open = true;
+    EXPECT_EQ(stew::Job::Status::Completed, future.get());
+}
+
+TEST_P(CoroutineTest, awaitStoppedJob)
+{
+    auto pool = stew::Library::instance().threadPool();
+    if (!pool)
+    {
+        GTEST_SKIP() << "The job awaiter needs a thread pool.";
+    }
+    auto blocker = std::make_shared<GateJob>();
+    auto job = std::make_shared<GateJob>();
+    ASSERT_TRUE(pool->tryScheduleJob(blocker));
+    ASSERT_TRUE(pool->tryScheduleJob(job));
+
+    auto future = awaitJob(job);
+    job->stop();
+    job->open = true;
+    blocker->open = true;
+    EXPECT_EQ(stew::Job::Status::Stopped, future.get());
+}
+
+TEST_P(CoroutineTest, awaitDeferredJob)
+{
+    auto job = std::make_shared<GateJob>();
+    auto future = awaitJob(job);
+    EXPECT_TRUE(future.isReady());
+    EXPECT_EQ(stew::Job::Status::Deferred, future.get());
+}
+
+TEST_P(CoroutineTest, awaitDelay)
+{
+    auto future = awaitDelay(20ms);
+    EXPECT_GE(future.get(), 20ms);
+}
+
+TEST_P(CoroutineTest, awaitFutures)
+{
+    EXPECT_EQ(3, awaitFutures().get());
+}
+
+TEST(CoroutineStandaloneTest, resumeOnStoppedPoolBreaksPromise)
+{
+    stew::ThreadPool pool(1u);
+    pool.start();
+    pool.stop();
+
+    auto future = hopToPool(&pool);
+    EXPECT_THROW(future.get(), std::future_error);
+}
+
+TEST(CoroutineStandaloneTest, delayBreaksPromiseWhenPoolStops)
+{
+    stew::ThreadPool pool(1u);
+    pool.start();
+
+    auto delayed = [](stew::ThreadPool* pool) -> stew::Future<void>
+    {
+        co_await stew::resumeOn(pool);
+        co_await stew::delay(10s);
+    }(&pool);
+    while (pool.getQueuedJobs() > 0u || pool.isBusy())
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    pool.stop();
+    EXPECT_THROW(delayed.get(), std::future_error);
+}
+
+TEST(CoroutineStandaloneTest, awaitFutureBreaksPromiseWhenPoolStops)
+{
+    stew::ThreadPool pool(1u);
+    stew::ThreadPool producerPool(1u);
+    pool.start();
+    producerPool.start();
+
+    std::atomic_bool open = false;
+    auto produced = stew::async(&producerPool, [&open]()
+    {
+        while (!open)
+        {
+            std::this_thread::yield();
+        }
+        return 1;
+    });
+    auto awaiting = [](stew::ThreadPool* pool, stew::Future<int> future) -> stew::Future<int>
+    {
+        co_await stew::resumeOn(pool);
+        co_return co_await future;
+    }(&pool, std::move(produced));
+    while (pool.getQueuedJobs() > 0u || pool.isBusy())
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    // The stopped pool rejects the resumption of the coroutine.
+    pool.stop();
+    open = true;
+    EXPECT_THROW(awaiting.get(), std::future_error);
+    producerPool.stop();
+}
+
+TEST(CoroutineStandaloneTest, delaySettlesWhenPoolStopsAsDelayIsDue)
+{
+    constexpr auto delayCount = 500u;
+    for (auto round = 0u; round < 20u; ++round)
+    {
+        stew::ThreadPool pool(2u);
+        pool.start();
+
+        std::vector<stew::Future<void>> delays;
+        for (auto i = 0u; i < delayCount; ++i)
+        {
+            delays.push_back([](stew::ThreadPool* pool) -> stew::Future<void>
+            {
+                co_await stew::resumeOn(pool);
+                co_await stew::delay(2ms);
+            }(&pool));
+        }
+        // Stop the pool around the time the delays are due.
+        std::this_thread::sleep_for(2ms + std::chrono::microseconds(round * 50u));
+        pool.stop();
+
+        // Each coroutine either resumed after its delay, or got its promise broken.
+        const auto deadline = std::chrono::steady_clock::now() + 10s;
+        for (auto& delayed : delays)
+        {
+            while (!delayed.isReady() && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(1ms);
+            }
+            ASSERT_TRUE(delayed.isReady());
+            try
+            {
+                delayed.get();
+            }
+            catch (const std::future_error& error)
+            {
+                EXPECT_EQ(std::future_errc::broken_promise, error.code());
+            }
+        }
+    }
+}
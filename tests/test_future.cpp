@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/future.hpp>
+#include <stew/tasks/job.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace
+{
+
+class FutureTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+};
+
+class CountingJob : public stew::Job
+{
+public:
+    std::atomic_size_t runCount = 0u;
+    std::atomic<stew::ThreadPool*> pool = nullptr;
+
+protected:
+    void run() override
+    {
+        pool = stew::ThreadPool::getCurrent();
+        ++runCount;
+    }
+};
+
+class ExecutorTest : public DomainTestEnvironment
+{
+protected:
+    void SetUp() override
+    {
+        auto arguments = stew::LibraryArguments();
+        auto& executor = arguments.executors.emplace_back();
+        executor.name = "io";
+        executor.threadCount = 2u;
+        initializeDomain(arguments, true);
+    }
+};
+
+class InlineExecutorTest : public DomainTestEnvironment
+{
+protected:
+    void SetUp() override
+    {
+        auto arguments = stew::LibraryArguments();
+        arguments.threadPool.createThreadPool = false;
+        arguments.executors.emplace_back().name = "io";
+        initializeDomain(arguments, true);
+    }
+};
+
+}
+
+INSTANTIATE_TEST_SUITE_P(FutureTests, FutureTest, ::testing::Values(true, false));
+
+TEST_P(FutureTest, asyncReturnsValue)
+{
+    auto future = stew::async([]() { return 42; });
+    EXPECT_TRUE(future.isValid());
+    EXPECT_EQ(42, future.get());
+    EXPECT_FALSE(future.isValid());
+}
+
+TEST_P(FutureTest, asyncWithArguments)
+{
+    auto future = stew::async([](int a, std::string b) { return std::to_string(a) + b; }, 1, std::string("2"));
+    EXPECT_EQ("12", future.get());
+}
+
+TEST_P(FutureTest, asyncVoidFunction)
+{
+    std::atomic_bool called = false;
+    auto future = stew::async([&called]() { called = true; });
+    future.wait();
+    EXPECT_TRUE(future.isReady());
+    future.get();
+    EXPECT_TRUE(called);
+}
+
+TEST_P(FutureTest, asyncRethrowsException)
+{
+    auto future = stew::async([]() -> int { throw std::runtime_error("failure"); });
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST_P(FutureTest, thenChainsResults)
+{
+    auto future = stew::async([]() { return 1; })
+                      .then([](int value) { return value + 1; })
+                      .then([](int value) { return std::to_string(value); });
+    EXPECT_EQ("2", future.get());
+}
+
+TEST_P(FutureTest, thenOnReadyFuture)
+{
+    auto future = stew::async([]() { return 10; });
+    future.wait();
+    auto chained = future.then([](int value) { return value * 2; });
+    EXPECT_FALSE(future.isValid());
+    EXPECT_EQ(20, chained.get());
+}
+
+TEST_P(FutureTest, thenAfterVoidFuture)
+{
+    auto future = stew::async([]() {}).then([]() { return std::string("done"); });
+    EXPECT_EQ("done", future.get());
+}
+
+TEST_P(FutureTest, thenSkippedOnException)
+{
+    std::atomic_bool called = false;
+    auto future = stew::async([]() -> int { throw std::runtime_error("failure"); })
+                      .then([&called](int value) { called = true; return value; });
+    EXPECT_THROW(future.get(), std::runtime_error);
+    EXPECT_FALSE(called);
+}
+
+TEST_P(FutureTest, thenRunsOnThreadPool)
+{
+    if (!GetParam())
+    {
+        GTEST_SKIP() << "single threaded";
+    }
+    const auto mainThread = std::this_thread::get_id();
+    auto future = stew::async([]() { return 1; }).then([](int) { return std::this_thread::get_id(); });
+    EXPECT_NE(mainThread, future.get());
+}
+
+TEST_P(FutureTest, asyncJobStillSchedulesJob)
+{
+    auto job = std::make_shared<CountingJob>();
+    EXPECT_TRUE(stew::async(job));
+    job->wait();
+    EXPECT_EQ(1u, job->runCount);
+}
+
+TEST_F(ExecutorTest, asyncOnNamedExecutor)
+{
+    auto executor = stew::Library::instance().executor("io");
+    ASSERT_NE(nullptr, executor);
+    EXPECT_EQ(2u, executor->getThreadCount());
+
+    auto future = stew::async("io", []() { return stew::ThreadPool::getCurrent(); });
+    EXPECT_EQ(executor, future.get());
+
+    auto job = std::make_shared<CountingJob>();
+    EXPECT_TRUE(stew::async("io", job));
+    job->wait();
+    EXPECT_EQ(executor, job->pool);
+}
+
+TEST_F(ExecutorTest, asyncOnPoolHandle)
+{
+    auto executor = stew::Library::instance().executor("io");
+    auto future = stew::async(executor, [](int value) { return std::make_pair(value, stew::ThreadPool::getCurrent()); }, 3);
+    EXPECT_EQ(std::make_pair(3, executor), future.get());
+
+    auto job = std::make_shared<CountingJob>();
+    EXPECT_TRUE(stew::async(executor, job));
+    job->wait();
+    EXPECT_EQ(executor, job->pool);
+}
+
+TEST_F(ExecutorTest, unknownExecutorRejectsWork)
+{
+    EXPECT_EQ(nullptr, stew::Library::instance().executor("compute"));
+    bool called = false;
+    auto future = stew::async("compute", [&called]() { called = true; });
+    EXPECT_THROW(future.get(), std::future_error);
+    EXPECT_FALSE(called);
+
+    auto job = std::make_shared<CountingJob>();
+    EXPECT_FALSE(stew::async("compute", job));
+    EXPECT_EQ(stew::Job::Status::Deferred, job->getStatus());
+    EXPECT_EQ(0u, job->runCount);
+}
+
+TEST_F(InlineExecutorTest, declaredExecutorRunsWorkOnCallingThread)
+{
+    EXPECT_TRUE(stew::Library::instance().hasExecutor("io"));
+    EXPECT_EQ(nullptr, stew::Library::instance().executor("io"));
+
+    const auto caller = std::this_thread::get_id();
+    auto future = stew::async("io", []() { return std::this_thread::get_id(); });
+    EXPECT_EQ(caller, future.get());
+
+    auto job = std::make_shared<CountingJob>();
+    EXPECT_TRUE(stew::async("io", job));
+    EXPECT_EQ(1u, job->runCount);
+
+    // An unknown name still rejects the work.
+    EXPECT_FALSE(stew::Library::instance().hasExecutor("compute"));
+    EXPECT_FALSE(stew::async("compute", std::make_shared<CountingJob>()));
+    EXPECT_THROW(stew::async("compute", []() {}).get(), std::future_error);
+
+#ifdef CONFIG_ENABLE_LOGS
+    auto tracerJob = std::make_shared<CountingJob>();
+    EXPECT_TRUE(stew::async("tracer", tracerJob));
+    EXPECT_EQ(1u, tracerJob->runCount);
+#endif
+}
+
+#ifdef CONFIG_ENABLE_LOGS
+TEST_F(ExecutorTest, tracerHasDedicatedExecutor)
+{
+    auto executor = stew::Library::instance().executor("tracer");
+    ASSERT_NE(nullptr, executor);
+    EXPECT_EQ(1u, executor->getThreadCount());
+    EXPECT_EQ(stew::JobPriority::Background, executor->getThreadPriority());
+}
+#endif
+
+TEST(FutureStopTest, stoppedPoolBreaksPromise)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.start();
+    threadPool.stop();
+
+    using Task = stew::detail::AsyncTask<int, std::function<int()>>;
+    auto task = std::make_shared<Task>(&threadPool, []() { return 1; });
+    stew::Future<int> future(task);
+    stew::detail::AsyncTaskBase::dispatch(task);
+    EXPECT_THROW(future.get(), std::future_error);
+}
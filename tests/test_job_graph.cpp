@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/job_graph.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Records the order of the job runs.
+class RecordingJob : public stew::Job
+{
+    std::mutex& m_lock;
+    std::vector<std::string>& m_order;
+    std::string m_name;
+
+public:
+    explicit RecordingJob(std::mutex& lock, std::vector<std::string>& order, std::string name) :
+        m_lock(lock),
+        m_order(order),
+        m_name(std::move(name))
+    {
+    }
+
+protected:
+    void run() override
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_order.push_back(m_name);
+    }
+};
+
+// Stops itself when it runs.
+class StoppingJob : public stew::Job
+{
+protected:
+    void run() override
+    {
+        stop();
+    }
+};
+
+// Holds a thread of the pool till stopped.
+class BlockingJob : public stew::Job
+{
+public:
+    std::atomic_bool started = false;
+
+protected:
+    void run() override
+    {
+        started = true;
+        while (!isStopped())
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+
+class JobGraphTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    std::mutex m_lock;
+    std::vector<std::string> m_order;
+
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+
+    stew::JobPtr createJob(std::string name)
+    {
+        return std::make_shared<RecordingJob>(m_lock, m_order, std::move(name));
+    }
+
+    std::size_t indexOf(const std::string& name)
+    {
+        return std::distance(m_order.begin(), std::find(m_order.begin(), m_order.end(), name));
+    }
+};
+
+}
+
+INSTANTIATE_TEST_SUITE_P(JobGraphTests, JobGraphTest, ::testing::Values(true, false));
+
+TEST_P(JobGraphTest, runsJobsInDependencyOrder)
+{
+    auto a = createJob("a");
+    auto b = createJob("b");
+    auto c = createJob("c");
+    auto d = createJob("d");
+
+    stew::JobGraph graph;
+    graph.addDependency(a, b);
+    graph.addDependency(a, c);
+    graph.addDependency(b, d);
+    graph.addDependency(c, d);
+    EXPECT_EQ(4u, graph.getJobCount());
+
+    EXPECT_TRUE(graph.start());
+    graph.wait();
+    EXPECT_FALSE(graph.isRunning());
+    EXPECT_FALSE(graph.isStopped());
+
+    ASSERT_EQ(4u, m_order.size());
+    EXPECT_LT(indexOf("a"), indexOf("b"));
+    EXPECT_LT(indexOf("a"), indexOf("c"));
+    EXPECT_LT(indexOf("b"), indexOf("d"));
+    EXPECT_LT(indexOf("c"), indexOf("d"));
+}
+
+TEST_P(JobGraphTest, independentJobs)
+{
+    stew::JobGraph graph;
+    graph.addJob(createJob("a"));
+    graph.addJob(createJob("b"));
+    auto c = createJob("c");
+    graph.addJob(c);
+    graph.addJob(c);
+    EXPECT_EQ(3u, graph.getJobCount());
+
+    EXPECT_TRUE(graph.start());
+    graph.wait();
+    EXPECT_EQ(3u, m_order.size());
+}
+
+TEST_P(JobGraphTest, restartCompletedGraph)
+{
+    stew::JobGraph graph;
+    graph.addDependency(createJob("a"), createJob("b"));
+
+    EXPECT_TRUE(graph.start());
+    graph.wait();
+    EXPECT_TRUE(graph.start());
+    graph.wait();
+
+    std::vector<std::string> expected = {"a", "b", "a", "b"};
+    EXPECT_EQ(expected, m_order);
+}
+
+TEST_P(JobGraphTest, graphWithCycleDoesNotStart)
+{
+    auto a = createJob("a");
+    auto b = createJob("b");
+    auto c = createJob("c");
+
+    stew::JobGraph graph;
+    graph.addDependency(a, b);
+    graph.addDependency(b, c);
+    graph.addDependency(c, a);
+
+    EXPECT_FALSE(graph.start());
+    EXPECT_FALSE(graph.isRunning());
+    EXPECT_TRUE(m_order.empty());
+}
+
+TEST_P(JobGraphTest, stoppedJobStopsSuccessors)
+{
+    auto a = createJob("a");
+    auto stopping = std::make_shared<StoppingJob>();
+    auto b = createJob("b");
+    auto c = createJob("c");
+
+    stew::JobGraph graph;
+    graph.addDependency(a, stopping);
+    graph.addDependency(stopping, b);
+    graph.addDependency(b, c);
+
+    EXPECT_TRUE(graph.start());
+    graph.wait();
+    EXPECT_TRUE(graph.isStopped());
+
+    std::vector<std::string> expected = {"a"};
+    EXPECT_EQ(expected, m_order);
+    EXPECT_TRUE(b->isStopped());
+    EXPECT_TRUE(c->isStopped());
+}
+
+TEST_P(JobGraphTest, stopRunningGraph)
+{
+    if (!GetParam())
+    {
+        GTEST_SKIP() << "single threaded";
+    }
+
+    auto blocking = std::make_shared<BlockingJob>();
+    auto b = createJob("b");
+
+    stew::JobGraph graph;
+    graph.addDependency(blocking, b);
+
+    EXPECT_TRUE(graph.start());
+    while (!blocking->started)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(graph.isRunning());
+
+    graph.stop();
+    graph.wait();
+    EXPECT_TRUE(graph.isStopped());
+    EXPECT_TRUE(blocking->isStopped());
+    EXPECT_TRUE(b->isStopped());
+    EXPECT_TRUE(m_order.empty());
+}
+
+TEST_P(JobGraphTest, waitOnSingleThreadedPool)
+{
+    // The graph waits from inside a job of a single threaded pool, so the waiting thread must run the
+    // jobs of the graph.
+    class GraphJob : public stew::Job
+    {
+    public:
+        stew::ThreadPool& pool;
+        stew::JobPtr first;
+        stew::JobPtr second;
+
+        explicit GraphJob(stew::ThreadPool& pool, stew::JobPtr first, stew::JobPtr second) :
+            pool(pool),
+            first(std::move(first)),
+            second(std::move(second))
+        {
+        }
+
+    protected:
+        void run() override
+        {
+            stew::JobGraph graph(&pool);
+            graph.addDependency(first, second);
+            EXPECT_TRUE(graph.start());
+            graph.wait();
+        }
+    };
+
+    stew::ThreadPool pool(1u);
+    pool.start();
+    auto job = std::make_shared<GraphJob>(pool, createJob("a"), createJob("b"));
+    ASSERT_TRUE(pool.tryScheduleJob(job));
+    job->wait();
+    pool.stop();
+
+    ASSERT_EQ(2u, m_order.size());
+    EXPECT_LT(indexOf("a"), indexOf("b"));
+}
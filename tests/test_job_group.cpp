@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/job.hpp>
+#include <stew/tasks/job_group.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+class JobGroupTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+};
+
+class CountingJob : public stew::Job
+{
+public:
+    explicit CountingJob(std::atomic_size_t& counter) :
+        m_counter(counter)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        ++m_counter;
+    }
+
+private:
+    std::atomic_size_t& m_counter;
+};
+
+class GateJob : public stew::Job
+{
+public:
+    std::atomic_bool open = false;
+
+protected:
+    void run() override
+    {
+        while (!open && !isStopped())
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+
+// Fans out jobs to a group, and waits for them from inside the job.
+class FanOutJob : public stew::Job
+{
+public:
+    explicit FanOutJob(std::atomic_size_t& counter) :
+        m_counter(counter)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        stew::JobGroup group;
+        for (auto i = 0u; i < 10u; ++i)
+        {
+            group.addJob(std::make_shared<CountingJob>(m_counter));
+        }
+        group.waitAll();
+        EXPECT_EQ(0u, group.getPendingCount());
+    }
+
+private:
+    std::atomic_size_t& m_counter;
+};
+
+}
+
+INSTANTIATE_TEST_SUITE_P(JobGroupTests, JobGroupTest, ::testing::Values(true, false));
+
+TEST_P(JobGroupTest, waitAllJobs)
+{
+    std::atomic_size_t counter = 0u;
+    stew::JobGroup group;
+    for (auto i = 0u; i < 20u; ++i)
+    {
+        EXPECT_TRUE(group.addJob(std::make_shared<CountingJob>(counter)));
+    }
+    group.waitAll();
+
+    EXPECT_EQ(20u, counter);
+    EXPECT_EQ(0u, group.getPendingCount());
+    auto timing = group.getTiming();
+    EXPECT_EQ(20u, timing.completedCount);
+    EXPECT_EQ(0u, timing.stoppedCount);
+    EXPECT_GE(timing.totalLatency, timing.maxLatency);
+    EXPECT_GE(timing.busyTime, timing.maxLatency);
+}
+
+TEST_P(JobGroupTest, waitAllFromJobHelps)
+{
+    std::atomic_size_t counter = 0u;
+    auto job = std::make_shared<FanOutJob>(counter);
+    ASSERT_TRUE(stew::async(job));
+    job->wait();
+    EXPECT_EQ(10u, counter);
+}
+
+TEST_P(JobGroupTest, cancelAllStopsPendingJobs)
+{
+    auto pool = stew::Library::instance().threadPool();
+    if (!pool)
+    {
+        GTEST_SKIP() << "The jobs of the group run synchronously without a thread pool.";
+    }
+
+    stew::JobGroup group;
+    std::vector<std::shared_ptr<GateJob>> jobs;
+    for (auto i = 0u; i < 5u; ++i)
+    {
+        jobs.push_back(std::make_shared<GateJob>());
+        EXPECT_TRUE(group.addJob(jobs.back()));
+    }
+    EXPECT_EQ(5u, group.getPendingCount());
+
+    group.cancelAll();
+    group.waitAll();
+    EXPECT_EQ(0u, group.getPendingCount());
+    for (auto& job : jobs)
+    {
+        EXPECT_TRUE(job->isStopped());
+    }
+    EXPECT_EQ(5u, group.getTiming().stoppedCount);
+}
+
+TEST_P(JobGroupTest, cancelAllSparesOtherJobs)
+{
+    auto pool = stew::Library::instance().threadPool();
+    if (!pool)
+    {
+        GTEST_SKIP() << "The jobs of the group run synchronously without a thread pool.";
+    }
+
+    auto other = std::make_shared<GateJob>();
+    ASSERT_TRUE(pool->tryScheduleJob(other));
+
+    stew::JobGroup group;
+    auto member = std::make_shared<GateJob>();
+    EXPECT_TRUE(group.addJob(member));
+    group.cancelAll();
+    group.waitAll();
+
+    EXPECT_TRUE(member->isStopped());
+    EXPECT_FALSE(other->isStopped());
+    other->open = true;
+    other->wait();
+}
+
+TEST_P(JobGroupTest, addPendingJobFails)
+{
+    auto pool = stew::Library::instance().threadPool();
+    if (!pool)
+    {
+        GTEST_SKIP() << "The jobs of the group run synchronously without a thread pool.";
+    }
+
+    stew::JobGroup group;
+    auto job = std::make_shared<GateJob>();
+    EXPECT_TRUE(group.addJob(job));
+    EXPECT_FALSE(group.addJob(job));
+    EXPECT_EQ(1u, group.getPendingCount());
+
+    job->open = true;
+    group.waitAll();
+    EXPECT_EQ(1u, group.getTiming().completedCount);
+}
+
+TEST_P(JobGroupTest, cancelAllWhileJobsStart)
+{
+    auto pool = stew::Library::instance().threadPool();
+    if (!pool)
+    {
+        GTEST_SKIP() << "The jobs of the group run synchronously without a thread pool.";
+    }
+
+    // Cancel the jobs while the threads of the pool take them off the queues.
+    std::atomic_size_t counter = 0u;
+    for (auto round = 0u; round < 20u; ++round)
+    {
+        stew::JobGroup group;
+        for (auto i = 0u; i < 100u; ++i)
+        {
+            group.addJob(std::make_shared<CountingJob>(counter));
+        }
+        group.cancelAll();
+        group.waitAll();
+        EXPECT_EQ(0u, group.getPendingCount());
+        auto timing = group.getTiming();
+        EXPECT_EQ(100u, timing.completedCount + timing.stoppedCount);
+    }
+}
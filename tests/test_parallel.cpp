@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/parallel.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+class ParallelTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+};
+
+}
+
+INSTANTIATE_TEST_SUITE_P(ParallelTests, ParallelTest, ::testing::Values(true, false));
+
+TEST_P(ParallelTest, parallelForVisitsEachIndexOnce)
+{
+    std::vector<std::atomic_int> visits(1000u);
+    stew::parallelFor(0, 1000, [&visits](int index) { ++visits[index]; });
+    EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](auto& count) { return count == 1; }));
+}
+
+TEST_P(ParallelTest, parallelForWithGrainSize)
+{
+    std::atomic_size_t sum = 0u;
+    stew::parallelFor(std::size_t(0u), std::size_t(100u), [&sum](std::size_t index) { sum += index; }, 3u);
+    EXPECT_EQ(4950u, sum);
+}
+
+TEST_P(ParallelTest, parallelForEmptyRange)
+{
+    std::atomic_int calls = 0;
+    stew::parallelFor(10, 10, [&calls](int) { ++calls; });
+    stew::parallelFor(10, 0, [&calls](int) { ++calls; });
+    EXPECT_EQ(0, calls);
+}
+
+TEST_P(ParallelTest, parallelForOnElements)
+{
+    std::vector<int> values(500u, 1);
+    stew::parallelFor(values.begin(), values.end(), [](int& value) { value *= 2; }, 16u);
+    EXPECT_TRUE(std::all_of(values.begin(), values.end(), [](int value) { return value == 2; }));
+}
+
+TEST_P(ParallelTest, parallelForRethrowsException)
+{
+    auto function = [](int index)
+    {
+        if (index == 42)
+        {
+            throw std::runtime_error("failure");
+        }
+    };
+    EXPECT_THROW(stew::parallelFor(0, 100, function, 4u), std::runtime_error);
+}
+
+TEST_P(ParallelTest, parallelReduce)
+{
+    std::vector<long> values(10000u);
+    std::iota(values.begin(), values.end(), 1);
+    EXPECT_EQ(50005000, stew::parallelReduce(values.begin(), values.end(), 0l));
+    EXPECT_EQ(50005010, stew::parallelReduce(values.begin(), values.end(), 10l, std::plus<>(), 7u));
+
+    std::vector<long> empty;
+    EXPECT_EQ(5, stew::parallelReduce(empty.begin(), empty.end(), 5l));
+}
+
+TEST_P(ParallelTest, parallelReduceWithOperation)
+{
+    std::vector<std::string> values = {"c", "a", "d", "b"};
+    auto longest = [](std::string a, const std::string& b) { return std::max(a, b); };
+    EXPECT_EQ("d", stew::parallelReduce(values.begin(), values.end(), std::string(), longest, 1u));
+}
+
+TEST_P(ParallelTest, parallelSort)
+{
+    std::vector<int> values(20000u);
+    std::mt19937 random(7u);
+    std::generate(values.begin(), values.end(), [&random]() { return static_cast<int>(random() % 1000u); });
+
+    auto expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    stew::parallelSort(values.begin(), values.end());
+    EXPECT_EQ(expected, values);
+
+    std::sort(expected.begin(), expected.end(), std::greater<>());
+    stew::parallelSort(values.begin(), values.end(), std::greater<>(), 100u);
+    EXPECT_EQ(expected, values);
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/pipeline.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+class PipelineTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+};
+
+}
+
+INSTANTIATE_TEST_SUITE_P(PipelineTests, PipelineTest, ::testing::Values(true, false));
+
+TEST_P(PipelineTest, itemsFlowThroughStages)
+{
+    std::atomic_size_t sum = 0u;
+    auto pipeline = stew::PipelineBuilder<int>()
+        .then([](int value) { return value * 2; })
+        .then([](int value) { return std::to_string(value); })
+        .sink([&sum](std::string value) { sum += std::stoul(value); });
+
+    for (auto i = 1; i <= 100; ++i)
+    {
+        EXPECT_TRUE(pipeline.push(i));
+    }
+    pipeline.wait();
+
+    EXPECT_EQ(10100u, sum);
+    EXPECT_EQ(0u, pipeline.getPendingCount());
+
+    auto metrics = pipeline.getMetrics();
+    ASSERT_EQ(3u, metrics.size());
+    for (auto& stage : metrics)
+    {
+        EXPECT_EQ(100u, stage.processedCount);
+        EXPECT_EQ(0u, stage.queueDepth);
+        EXPECT_EQ(stew::PipelineBuilder<int>::DefaultCapacity, stage.capacity);
+        EXPECT_GT(stage.getThroughput(), 0.0);
+    }
+}
+
+TEST_P(PipelineTest, itemsKeepTheirOrder)
+{
+    std::vector<int> order;
+    auto pipeline = stew::PipelineBuilder<int>(nullptr, 4u)
+        .then([](int value) { return value + 1; }, 8u)
+        .sink([&order](int value) { order.push_back(value); }, 8u);
+
+    for (auto i = 0; i < 500; ++i)
+    {
+        EXPECT_TRUE(pipeline.push(i));
+    }
+    pipeline.wait();
+
+    ASSERT_EQ(500u, order.size());
+    for (auto i = 0; i < 500; ++i)
+    {
+        EXPECT_EQ(i + 1, order[i]);
+    }
+}
+
+TEST_P(PipelineTest, fullChannelsApplyBackpressure)
+{
+    // The blocked sink holds a thread, so the other stages need a pool of their own.
+    stew::ThreadPool threadPool(4u);
+    threadPool.start();
+
+    std::atomic_bool gate = false;
+    std::atomic_size_t consumed = 0u;
+    auto pipeline = stew::PipelineBuilder<int>(&threadPool)
+        .then([](int value) { return value; }, 2u)
+        .sink([&gate, &consumed](int)
+        {
+            gate.wait(false);
+            ++consumed;
+        }, 2u);
+
+    // The blocked sink holds an item, and the channels of the stages fill up.
+    auto pushed = 0u;
+    for (auto deadline = std::chrono::steady_clock::now() + 5s; pushed < 5u && std::chrono::steady_clock::now() < deadline;)
+    {
+        if (pipeline.tryPush(int(pushed)))
+        {
+            ++pushed;
+            continue;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(5u, pushed);
+    std::this_thread::sleep_for(10ms);
+    EXPECT_FALSE(pipeline.tryPush(-1));
+
+    auto metrics = pipeline.getMetrics();
+    EXPECT_EQ(2u, metrics[0].queueDepth);
+    EXPECT_EQ(2u, metrics[1].queueDepth);
+    EXPECT_EQ(2u, metrics[1].maxQueueDepth);
+    EXPECT_EQ(0u, consumed);
+
+    gate = true;
+    gate.notify_all();
+    pipeline.wait();
+    EXPECT_EQ(pushed, consumed);
+    threadPool.stop();
+}
+
+TEST_P(PipelineTest, pushWaitsForRoom)
+{
+    std::atomic_size_t consumed = 0u;
+    auto pipeline = stew::PipelineBuilder<int>(nullptr, 1u)
+        .then([](int value) { return value; }, 1u)
+        .sink([&consumed](int)
+        {
+            std::this_thread::sleep_for(100us);
+            ++consumed;
+        }, 1u);
+
+    for (auto i = 0; i < 50; ++i)
+    {
+        EXPECT_TRUE(pipeline.push(i));
+    }
+    pipeline.wait();
+
+    EXPECT_EQ(50u, consumed);
+    auto metrics = pipeline.getMetrics();
+    EXPECT_EQ(1u, metrics[0].maxQueueDepth);
+    EXPECT_EQ(1u, metrics[1].maxQueueDepth);
+}
+
+TEST_P(PipelineTest, closedPipelineRejectsItems)
+{
+    std::atomic_size_t consumed = 0u;
+    auto pipeline = stew::PipelineBuilder<int>()
+        .sink([&consumed](int) { ++consumed; });
+
+    EXPECT_TRUE(pipeline.push(1));
+    pipeline.close();
+    EXPECT_TRUE(pipeline.isClosed());
+    EXPECT_FALSE(pipeline.push(2));
+    EXPECT_FALSE(pipeline.tryPush(3));
+    pipeline.wait();
+
+    EXPECT_EQ(1u, consumed);
+    EXPECT_EQ(0u, pipeline.getPendingCount());
+}
+
+TEST_P(PipelineTest, stagesKeepItemsOnFullBoundedPool)
+{
+    for (auto policy : {stew::ThreadPool::OverflowPolicy::Reject, stew::ThreadPool::OverflowPolicy::DropOldest})
+    {
+        // Without the next job slot, the stages activate each other through the shared queue of the
+        // pool, which holds a single job.
+        stew::ThreadPool threadPool(1u);
+        threadPool.setQueueCapacity(1u);
+        threadPool.setOverflowPolicy(policy);
+        threadPool.setNextJobSlotLimit(0u);
+        threadPool.start();
+
+        // Hold the thread of the pool, so that the activation of the first stage stays queued.
+        std::atomic_bool started = false;
+        std::atomic_bool gate = false;
+        EXPECT_TRUE(threadPool.post([&started, &gate]()
+        {
+            started = true;
+            gate.wait(false);
+        }));
+        while (!started)
+        {
+            std::this_thread::yield();
+        }
+
+        std::vector<int> order;
+        auto pipeline = stew::PipelineBuilder<int>(&threadPool, 1u)
+            .then([](int value) { return value; })
+            .sink([&order](int value) { order.push_back(value); });
+        for (auto i = 0; i < 10; ++i)
+        {
+            EXPECT_TRUE(pipeline.tryPush(i));
+        }
+        // The overflow policy does not drop the queued activation of the stage.
+        EXPECT_FALSE(threadPool.post([]() {}));
+
+        gate = true;
+        gate.notify_all();
+        pipeline.wait();
+        ASSERT_EQ(10u, order.size());
+        for (auto i = 0; i < 10; ++i)
+        {
+            EXPECT_EQ(i, order[i]);
+        }
+        threadPool.stop();
+    }
+}
+
+TEST_P(PipelineTest, pushOnPoolThreadParksForRoom)
+{
+    stew::ThreadPool stagePool(2u);
+    stagePool.start();
+    stew::ThreadPool producerPool(1u);
+    producerPool.start();
+
+    std::atomic_size_t consumed = 0u;
+    auto pipeline = stew::PipelineBuilder<int>(&stagePool, 1u)
+        .sink([&consumed](int)
+        {
+            std::this_thread::sleep_for(5ms);
+            ++consumed;
+        }, 1u);
+
+    auto getWakeupCount = [&producerPool]()
+    {
+        return producerPool.getMetrics().workers.front().wakeupCount;
+    };
+    const auto wakeupsBefore = getWakeupCount();
+    std::atomic_bool done = false;
+    EXPECT_TRUE(producerPool.post([&pipeline, &done]()
+    {
+        for (auto i = 0; i < 20; ++i)
+        {
+            pipeline.push(i);
+        }
+        pipeline.wait();
+        done = true;
+        done.notify_all();
+    }));
+    done.wait(false);
+
+    EXPECT_EQ(20u, consumed);
+    // The producer thread wakes once to take the post. A producer which parks for room wakes again
+    // each time the sink frees room, while a spinning one never parks.
+    EXPECT_LE(wakeupsBefore + 2u, getWakeupCount());
+    producerPool.stop();
+    stagePool.stop();
+}
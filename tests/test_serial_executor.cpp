@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2024 bitWelder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <http://www.gnu.org/licenses/>
+ */
+
+#include "utils/domain_test_environment.hpp"
+
+#include <gtest/gtest.h>
+#include <stew/tasks/serial_executor.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+class SerialExecutorTest : public DomainTestEnvironment, public ::testing::WithParamInterface<bool>
+{
+protected:
+    void SetUp() override
+    {
+        initializeDomain(GetParam(), true);
+    }
+
+    // Posts a marker task to the strand, and waits till the marker runs.
+    bool flush(stew::SerialExecutor::StrandPtr strand)
+    {
+        auto done = std::make_shared<std::atomic_bool>(false);
+        if (!strand->post([done]() { *done = true; }))
+        {
+            return false;
+        }
+        for (auto deadline = std::chrono::steady_clock::now() + 5s; !*done && std::chrono::steady_clock::now() < deadline;)
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+        return *done;
+    }
+};
+
+}
+
+INSTANTIATE_TEST_SUITE_P(SerialExecutorTests, SerialExecutorTest, ::testing::Values(true, false));
+
+TEST_P(SerialExecutorTest, tasksRunInPostOrder)
+{
+    stew::SerialExecutor executor;
+    auto strand = executor.createStrand();
+
+    std::vector<int> order;
+    for (auto i = 0; i < 100; ++i)
+    {
+        EXPECT_TRUE(strand->post([&order, i]() { order.push_back(i); }));
+    }
+    ASSERT_TRUE(flush(strand));
+
+    ASSERT_EQ(100u, order.size());
+    for (auto i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(i, order[i]);
+    }
+    EXPECT_EQ(0u, strand->getPendingCount());
+}
+
+TEST_P(SerialExecutorTest, tasksOfStrandDoNotOverlap)
+{
+    stew::SerialExecutor executor(nullptr, 4u);
+    auto strand = executor.createStrand();
+
+    std::atomic_size_t inFlight = 0u;
+    std::atomic_bool overlapped = false;
+    auto task = [&inFlight, &overlapped]()
+    {
+        if (++inFlight > 1u)
+        {
+            overlapped = true;
+        }
+        std::this_thread::yield();
+        --inFlight;
+    };
+
+    std::vector<std::thread> posters;
+    for (auto i = 0; i < 4; ++i)
+    {
+        posters.emplace_back([&strand, &task]()
+        {
+            for (auto j = 0; j < 50; ++j)
+            {
+                strand->post(task);
+            }
+        });
+    }
+    for (auto& poster : posters)
+    {
+        poster.join();
+    }
+    ASSERT_TRUE(flush(strand));
+    EXPECT_FALSE(overlapped);
+}
+
+TEST_P(SerialExecutorTest, strandsRunIndependently)
+{
+    stew::SerialExecutor executor;
+    auto strand1 = executor.createStrand();
+    auto strand2 = executor.createStrand();
+
+    std::atomic_int count1 = 0;
+    std::atomic_int count2 = 0;
+    for (auto i = 0; i < 20; ++i)
+    {
+        strand1->post([&count1]() { ++count1; });
+        strand2->post([&count2]() { ++count2; });
+    }
+    ASSERT_TRUE(flush(strand1));
+    ASSERT_TRUE(flush(strand2));
+    EXPECT_EQ(20, count1);
+    EXPECT_EQ(20, count2);
+}
+
+TEST_P(SerialExecutorTest, strandReschedulesAfterBatch)
+{
+    stew::SerialExecutor executor(nullptr, 2u);
+    EXPECT_EQ(2u, executor.getBatchSize());
+    auto strand = executor.createStrand();
+
+    std::atomic_int count = 0;
+    for (auto i = 0; i < 11; ++i)
+    {
+        strand->post([&count]() { ++count; });
+    }
+    ASSERT_TRUE(flush(strand));
+    EXPECT_EQ(11, count);
+}
+
+TEST_P(SerialExecutorTest, isCurrentInsideTask)
+{
+    stew::SerialExecutor executor;
+    auto strand = executor.createStrand();
+    auto other = executor.createStrand();
+
+    EXPECT_FALSE(strand->isCurrent());
+    std::atomic_bool current = false;
+    std::atomic_bool otherCurrent = true;
+    strand->post([&]()
+    {
+        current = strand->isCurrent();
+        otherCurrent = other->isCurrent();
+    });
+    ASSERT_TRUE(flush(strand));
+    EXPECT_TRUE(current);
+    EXPECT_FALSE(otherCurrent);
+}
+
+TEST_P(SerialExecutorTest, postFromTaskRunsAfterCurrentTask)
+{
+    stew::SerialExecutor executor;
+    auto strand = executor.createStrand();
+
+    std::mutex lock;
+    std::vector<int> order;
+    auto done = std::make_shared<std::atomic_bool>(false);
+    strand->post([&]()
+    {
+        strand->post([&, done]()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            order.push_back(2);
+            *done = true;
+        });
+        std::lock_guard<std::mutex> guard(lock);
+        order.push_back(1);
+    });
+    for (auto deadline = std::chrono::steady_clock::now() + 5s; !*done && std::chrono::steady_clock::now() < deadline;)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_TRUE(*done);
+    ASSERT_EQ(2u, order.size());
+    EXPECT_EQ(1, order[0]);
+    EXPECT_EQ(2, order[1]);
+}
+
+TEST_P(SerialExecutorTest, strandKeepsTasksOnFullBoundedPool)
+{
+    for (auto policy : {stew::ThreadPool::OverflowPolicy::Reject, stew::ThreadPool::OverflowPolicy::DropOldest})
+    {
+        // Without the next job slot, the strand reschedules itself to the shared queue of the pool.
+        stew::ThreadPool threadPool(1u);
+        threadPool.setQueueCapacity(1u);
+        threadPool.setOverflowPolicy(policy);
+        threadPool.setNextJobSlotLimit(0u);
+        threadPool.start();
+
+        // Hold the thread of the pool, so that the activation of the strand stays queued.
+        std::atomic_bool started = false;
+        std::atomic_bool gate = false;
+        EXPECT_TRUE(threadPool.post([&started, &gate]()
+        {
+            started = true;
+            gate.wait(false);
+        }));
+        while (!started)
+        {
+            std::this_thread::yield();
+        }
+
+        stew::SerialExecutor executor(&threadPool, 1u);
+        auto strand = executor.createStrand();
+        std::vector<int> order;
+        std::atomic_size_t fillerCount = 0u;
+        for (auto i = 0; i < 10; ++i)
+        {
+            // Fill the queue of the pool, so that the strand reschedules itself on a full pool.
+            EXPECT_TRUE(strand->post([&order, &threadPool, &fillerCount, i]()
+            {
+                order.push_back(i);
+                threadPool.post([&fillerCount]() { ++fillerCount; });
+            }));
+        }
+        // The overflow policy does not drop the queued activation of the strand.
+        EXPECT_FALSE(threadPool.post([]() {}));
+
+        gate = true;
+        gate.notify_all();
+        EXPECT_TRUE(threadPool.drain(std::chrono::steady_clock::now() + 10s));
+        ASSERT_EQ(10u, order.size());
+        for (auto i = 0; i < 10; ++i)
+        {
+            EXPECT_EQ(i, order[i]);
+        }
+        EXPECT_EQ(10u, fillerCount);
+    }
+}
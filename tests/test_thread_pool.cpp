@@ -25,9 +25,17 @@
 #include <stew/tasks/thread_pool.hpp>
 #include <stew/standalone/container/safe_queue.hpp>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <set>
 #include <string>
 
+#if defined(PLATFORM_CONFIG_HOST_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace
 {
 
@@ -92,16 +100,13 @@ public:
             return;
         }
 
-        auto successfulSchedule = false;
         auto self = shared_from_this();
         while (!m_queue.tryPush(std::string(text)))
-        {
-            successfulSchedule |= m_scheduler->tryScheduleJob(self);
-        }
-        if (!successfulSchedule)
         {
             m_scheduler->tryScheduleJob(self);
         }
+        // Schedule after every push. The job may have consumed the buffer after an earlier schedule.
+        m_scheduler->tryScheduleJob(self);
     }
 
 protected:
@@ -180,7 +185,91 @@ protected:
     }
 };
 
-class TaskSchedulerTest : public ::testing::Test
+class SpawningJob : public TestJob
+{
+    stew::ThreadPool* m_scheduler = nullptr;
+    OutputPtr m_out;
+
+public:
+    std::vector<stew::JobPtr> children;
+
+    explicit SpawningJob(stew::ThreadPool* scheduler, OutputPtr out, SecureInt& jobCount, std::size_t childCount) :
+        TestJob(out, jobCount),
+        m_scheduler(scheduler),
+        m_out(out)
+    {
+        while (childCount-- != 0u)
+        {
+            children.push_back(std::make_shared<TestJob>(out, jobCount));
+        }
+    }
+
+protected:
+    void run() override
+    {
+        for (auto& child : children)
+        {
+            m_scheduler->tryScheduleJob(child);
+        }
+    }
+};
+
+// Holds a thread of the pool till released.
+class GateJob : public stew::Job
+{
+public:
+    std::atomic_bool open = false;
+
+protected:
+    void run() override
+    {
+        while (!open && !isStopped())
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+using GateJobPtr = std::shared_ptr<GateJob>;
+
+// A gate job which counts its runs.
+class CountingGateJob : public GateJob
+{
+public:
+    std::atomic_size_t runCount = 0u;
+
+protected:
+    void run() override
+    {
+        ++runCount;
+        GateJob::run();
+    }
+};
+
+// Records the order of the job runs.
+class OrderedJob : public stew::Job
+{
+    std::mutex& m_lock;
+    std::vector<int>& m_order;
+    int m_id = 0;
+
+public:
+    explicit OrderedJob(std::mutex& lock, std::vector<int>& order, int id, stew::JobPriority priority) :
+        m_lock(lock),
+        m_order(order),
+        m_id(id)
+    {
+        setPriority(priority);
+    }
+
+protected:
+    void run() override
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_order.push_back(m_id);
+    }
+};
+
+class TaskSchedulerTest : public ::testing::TestWithParam<stew::ThreadPool::SchedulingMode>
 {
 protected:
     std::unique_ptr<stew::ThreadPool> threadPool;
@@ -189,6 +278,7 @@ protected:
     void SetUp() override
     {
         threadPool = std::make_unique<stew::ThreadPool>(std::thread::hardware_concurrency());
+        threadPool->setSchedulingMode(GetParam());
         if (!threadPool->isRunning())
         {
             threadPool->start();
@@ -232,8 +322,12 @@ protected:
             {
                 this->jobs.push_back(std::make_shared<JobType>(test.m_output, jobCount));
             }
-            test.threadPool->tryScheduleJobs(this->jobs);
-            test.threadPool->schedule(std::chrono::milliseconds(1));
+            const auto queued = test.threadPool->tryScheduleJobs(this->jobs);
+            // Wait till the queued jobs start, as a sleep may end before the woken threads run.
+            while (jobCount < queued)
+            {
+                std::this_thread::yield();
+            }
         }
 
     };
@@ -257,20 +351,30 @@ protected:
 
 }
 
-TEST_F(TaskSchedulerTest, testAddJobs)
+INSTANTIATE_TEST_SUITE_P(ThreadPoolTests,
+                         TaskSchedulerTest,
+                         ::testing::Values(stew::ThreadPool::SchedulingMode::SharedQueue,
+                                           stew::ThreadPool::SchedulingMode::WorkStealing));
+
+TEST_P(TaskSchedulerTest, testAddJobs)
 {
     constexpr auto maxJobs = 50u;
     QueuedTaskScenario<TestJob> scenario(*this, maxJobs);
-    ASSERT_EQ(scenario.jobCount, maxJobs);
-
     for (auto& job : scenario.jobs)
     {
         job->wait();
     }
+    EXPECT_EQ(scenario.jobCount, maxJobs);
+    // A job settles before the pool stops counting it as running, so the pool goes idle shortly after.
+    const auto deadline = stew::ThreadPool::Clock::now() + std::chrono::seconds(10);
+    while (threadPool->isBusy() && stew::ThreadPool::Clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
     EXPECT_FALSE(threadPool->isBusy());
 }
 
-TEST_F(TaskSchedulerTest, testAddQueuedJobs)
+TEST_P(TaskSchedulerTest, testAddQueuedJobs)
 {
     QueuedTaskScenario<QueuedJob> scenario(*this, 1u);
     EXPECT_EQ(scenario.jobCount, 1u);
@@ -284,7 +388,7 @@ TEST_F(TaskSchedulerTest, testAddQueuedJobs)
     EXPECT_EQ(m_output->getBuffer().size(), 3u);
 }
 
-TEST_F(TaskSchedulerTest, stressTestExclusiveJobs)
+TEST_P(TaskSchedulerTest, stressTestExclusiveJobs)
 {
     QueuedTaskScenario<QueuedJob> scenario(*this, threadPool->getThreadCount());
     EXPECT_EQ(scenario.jobCount, threadPool->getThreadCount());
@@ -295,7 +399,7 @@ TEST_F(TaskSchedulerTest, stressTestExclusiveJobs)
 
 }
 
-TEST_F(TaskSchedulerTest, reschedulingTask)
+TEST_P(TaskSchedulerTest, reschedulingTask)
 {
     ReschedulingTaskSchenario<ReusableJob> scenario(*this, 1u);
     scenario[0]->push("1st string");
@@ -309,7 +413,7 @@ TEST_F(TaskSchedulerTest, reschedulingTask)
     EXPECT_GE(scenario[0]->rescheduleCount, 1u);
 }
 
-TEST_F(TaskSchedulerTest, stressTestReschedulingTask)
+TEST_P(TaskSchedulerTest, stressTestReschedulingTask)
 {
     constexpr auto stressCount = 1000;
     ReschedulingTaskSchenario<ReusableJob> scenario(*this, 1u);
@@ -324,3 +428,1443 @@ TEST_F(TaskSchedulerTest, stressTestReschedulingTask)
     EXPECT_GE(scenario[0]->rescheduleCount, 1u);
     // std::cerr << "reschedule count = " << scenario[0]->rescheduleCount << std::endl;
 }
+
+TEST_P(TaskSchedulerTest, jobsScheduledFromJobs)
+{
+    constexpr auto childCount = 100u;
+    SecureInt jobCount = 0u;
+    auto job = std::make_shared<SpawningJob>(threadPool.get(), m_output, jobCount, childCount);
+
+    EXPECT_TRUE(threadPool->tryScheduleJob(job));
+    job->wait();
+    for (auto& child : job->children)
+    {
+        child->wait();
+    }
+    EXPECT_EQ(childCount, jobCount);
+}
+
+TEST(ThreadPoolTest, setSchedulingMode)
+{
+    stew::ThreadPool threadPool(2u);
+    EXPECT_EQ(stew::ThreadPool::SchedulingMode::SharedQueue, threadPool.getSchedulingMode());
+    threadPool.setSchedulingMode(stew::ThreadPool::SchedulingMode::WorkStealing);
+    EXPECT_EQ(stew::ThreadPool::SchedulingMode::WorkStealing, threadPool.getSchedulingMode());
+}
+
+TEST(ThreadPoolTest, stealJobsFromBusyThread)
+{
+    constexpr auto childCount = 20u;
+    stew::ThreadPool threadPool(4u);
+    threadPool.setSchedulingMode(stew::ThreadPool::SchedulingMode::WorkStealing);
+    threadPool.start();
+
+    // The spawner holds the thread which queues the children till the children complete, so the
+    // children must be stolen by the other threads.
+    class Spawner : public SpawningJob
+    {
+    public:
+        using SpawningJob::SpawningJob;
+
+    protected:
+        void run() override
+        {
+            SpawningJob::run();
+            const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (m_jobCount < childCount && std::chrono::steady_clock::now() < timeout)
+            {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    SecureInt jobCount = 0u;
+    auto spawner = std::make_shared<Spawner>(&threadPool, std::make_shared<Output>(), jobCount, childCount);
+    EXPECT_TRUE(threadPool.tryScheduleJob(spawner));
+    spawner->wait();
+    EXPECT_EQ(childCount, jobCount);
+
+    threadPool.stop();
+}
+
+TEST_P(TaskSchedulerTest, stopRunningJobs)
+{
+    QueuedTaskScenario<QueuedJob> scenario(*this, 1u);
+    while (scenario[0]->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(threadPool->isBusy());
+
+    threadPool->stop();
+    threadPool.reset();
+    EXPECT_TRUE(scenario[0]->isStopped());
+}
+
+TEST(ThreadPoolTest, serveJobsByPriority)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.start();
+
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+    while (gate->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+
+    std::mutex lock;
+    std::vector<int> order;
+    std::vector<stew::JobPtr> jobs = {
+        std::make_shared<OrderedJob>(lock, order, 3, stew::JobPriority::Background),
+        std::make_shared<OrderedJob>(lock, order, 2, stew::JobPriority::Normal),
+        std::make_shared<OrderedJob>(lock, order, 1, stew::JobPriority::High)
+    };
+    EXPECT_EQ(3u, threadPool.tryScheduleJobs(jobs));
+    EXPECT_EQ(3u, threadPool.getQueuedJobs());
+    EXPECT_EQ(1u, threadPool.getQueuedJobs(stew::JobPriority::High));
+    EXPECT_EQ(1u, threadPool.getQueuedJobs(stew::JobPriority::Normal));
+    EXPECT_EQ(1u, threadPool.getQueuedJobs(stew::JobPriority::Background));
+
+    gate->open = true;
+    for (auto& job : jobs)
+    {
+        job->wait();
+    }
+    EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+    EXPECT_EQ(0u, threadPool.getQueuedJobs(stew::JobPriority::Background));
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, serveJobsInOrderWhenInboundQueueIsFull)
+{
+    // More jobs than the inbound queue holds, so the submitter falls back to the locked queue.
+    constexpr int JobCount = 3000;
+    stew::ThreadPool threadPool(1u);
+    threadPool.start();
+
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+    while (gate->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+
+    std::mutex lock;
+    std::vector<int> order;
+    std::vector<stew::JobPtr> jobs;
+    for (int id = 0; id < JobCount; ++id)
+    {
+        jobs.push_back(std::make_shared<OrderedJob>(lock, order, id, stew::JobPriority::Normal));
+        EXPECT_TRUE(threadPool.tryScheduleJob(jobs.back()));
+    }
+
+    gate->open = true;
+    for (auto& job : jobs)
+    {
+        job->wait();
+    }
+    ASSERT_EQ(static_cast<std::size_t>(JobCount), order.size());
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, agedJobsServedBeforeHigherPriority)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.setPriorityAging(std::chrono::milliseconds(1));
+    threadPool.start();
+
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+
+    std::mutex lock;
+    std::vector<int> order;
+    auto background = std::make_shared<OrderedJob>(lock, order, 2, stew::JobPriority::Background);
+    auto high = std::make_shared<OrderedJob>(lock, order, 1, stew::JobPriority::High);
+    EXPECT_TRUE(threadPool.tryScheduleJob(background));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(threadPool.tryScheduleJob(high));
+
+    gate->open = true;
+    background->wait();
+    high->wait();
+    EXPECT_EQ(std::vector<int>({2, 1}), order);
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, serveJobsByDeadline)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.start();
+
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+    while (gate->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+
+    std::mutex lock;
+    std::vector<int> order;
+    const auto now = stew::ThreadPool::Clock::now();
+    auto noDeadline = std::make_shared<OrderedJob>(lock, order, 4, stew::JobPriority::High);
+    auto late = std::make_shared<OrderedJob>(lock, order, 3, stew::JobPriority::Normal);
+    late->setDeadline(now + std::chrono::seconds(30));
+    auto early = std::make_shared<OrderedJob>(lock, order, 1, stew::JobPriority::Background);
+    early->setDeadline(now + std::chrono::seconds(10));
+    auto middle = std::make_shared<OrderedJob>(lock, order, 2, stew::JobPriority::Normal);
+    middle->setDeadline(now + std::chrono::seconds(20));
+    std::vector<stew::JobPtr> jobs = {noDeadline, late, early, middle};
+    EXPECT_EQ(4u, threadPool.tryScheduleJobs(jobs));
+    EXPECT_EQ(4u, threadPool.getQueuedJobs());
+
+    gate->open = true;
+    for (auto& job : jobs)
+    {
+        job->wait();
+    }
+    EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), order);
+    EXPECT_EQ(0u, threadPool.getMissedDeadlineCount());
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, missedDeadlinePolicies)
+{
+    for (auto policy : {stew::ThreadPool::MissedDeadlinePolicy::Skip, stew::ThreadPool::MissedDeadlinePolicy::Demote, stew::ThreadPool::MissedDeadlinePolicy::Run})
+    {
+        stew::ThreadPool threadPool(1u);
+        threadPool.setMissedDeadlinePolicy(policy);
+        EXPECT_EQ(policy, threadPool.getMissedDeadlinePolicy());
+        threadPool.start();
+
+        auto gate = std::make_shared<GateJob>();
+        EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+        while (gate->getStatus() != stew::Job::Status::Running)
+        {
+            std::this_thread::yield();
+        }
+
+        std::mutex lock;
+        std::vector<int> order;
+        auto normal = std::make_shared<OrderedJob>(lock, order, 1, stew::JobPriority::Normal);
+        auto stale = std::make_shared<OrderedJob>(lock, order, 2, stew::JobPriority::High);
+        stale->setDeadline(stew::ThreadPool::Clock::now() + std::chrono::milliseconds(1));
+        EXPECT_TRUE(threadPool.tryScheduleJob(normal));
+        EXPECT_TRUE(threadPool.tryScheduleJob(stale));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        gate->open = true;
+        EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+        EXPECT_EQ(1u, threadPool.getMissedDeadlineCount());
+        switch (policy)
+        {
+            case stew::ThreadPool::MissedDeadlinePolicy::Skip:
+            {
+                EXPECT_TRUE(stale->isStopped());
+                EXPECT_EQ(std::vector<int>({1}), order);
+                break;
+            }
+            case stew::ThreadPool::MissedDeadlinePolicy::Demote:
+            {
+                EXPECT_EQ(std::vector<int>({1, 2}), order);
+                break;
+            }
+            default:
+            {
+                EXPECT_EQ(std::vector<int>({2, 1}), order);
+                break;
+            }
+        }
+    }
+}
+
+TEST(ThreadPoolTest, scheduleAfterDelay)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.start();
+
+    SecureInt jobCount = 0u;
+    auto job = std::make_shared<TestJob>(std::make_shared<Output>(), jobCount);
+    const auto start = stew::ThreadPool::Clock::now();
+    EXPECT_TRUE(threadPool.scheduleAfter(job, std::chrono::milliseconds(20)));
+    EXPECT_EQ(stew::Job::Status::Deferred, job->getStatus());
+
+    while (jobCount == 0u)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(stew::ThreadPool::Clock::now() - start, std::chrono::milliseconds(20));
+    job->wait();
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, scheduleAtTimePoint)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.start();
+
+    SecureInt jobCount = 0u;
+    auto job = std::make_shared<TestJob>(std::make_shared<Output>(), jobCount);
+    const auto dueTime = stew::ThreadPool::Clock::now() + std::chrono::milliseconds(10);
+    EXPECT_TRUE(threadPool.scheduleAt(job, dueTime));
+
+    while (jobCount == 0u)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(stew::ThreadPool::Clock::now(), dueTime);
+    job->wait();
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, scheduleAfterRetriesBusyJob)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.start();
+
+    auto job = std::make_shared<CountingGateJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(job));
+    while (job->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+    // The job is still running when due.
+    EXPECT_TRUE(threadPool.scheduleAfter(job, std::chrono::milliseconds(1)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(1u, job->runCount);
+
+    job->open = true;
+    while (job->runCount < 2u)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    job->wait();
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, schedulePeriodic)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.start();
+
+    SecureInt jobCount = 0u;
+    auto job = std::make_shared<TestJob>(std::make_shared<Output>(), jobCount);
+    EXPECT_TRUE(threadPool.schedulePeriodic(job, std::chrono::milliseconds(2)));
+
+    while (jobCount < 3u)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    job->stop();
+    const auto runs = jobCount.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_LE(jobCount, runs + 1u);
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, stopCancelsTimedJob)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.start();
+
+    SecureInt jobCount = 0u;
+    auto job = std::make_shared<TestJob>(std::make_shared<Output>(), jobCount);
+    EXPECT_TRUE(threadPool.scheduleAfter(job, std::chrono::milliseconds(5)));
+    job->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    EXPECT_EQ(0u, jobCount);
+    EXPECT_FALSE(threadPool.scheduleAfter(job, std::chrono::milliseconds(5)));
+
+    // Stopping the pool stops the pending timed jobs.
+    auto pending = std::make_shared<TestJob>(std::make_shared<Output>(), jobCount);
+    EXPECT_TRUE(threadPool.scheduleAfter(pending, std::chrono::seconds(10)));
+    threadPool.stop();
+    EXPECT_TRUE(pending->isStopped());
+    EXPECT_EQ(0u, jobCount);
+}
+
+TEST_P(TaskSchedulerTest, completionHandlerCalledWhenJobSettles)
+{
+    auto job = std::make_shared<GateJob>();
+    // A deferred job rejects the handler.
+    EXPECT_FALSE(job->addCompletionHandler([](stew::Job::Status) {}));
+
+    std::atomic<stew::Job::Status> settledStatus = stew::Job::Status::Deferred;
+    std::atomic_size_t handlerCount = 0u;
+    EXPECT_TRUE(threadPool->tryScheduleJob(job));
+    EXPECT_TRUE(job->addCompletionHandler([&](stew::Job::Status status)
+    {
+        settledStatus = status;
+        ++handlerCount;
+    }));
+    job->open = true;
+    job->wait();
+    while (handlerCount == 0u)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(stew::Job::Status::Completed, settledStatus.load());
+
+    // The handler is called only once.
+    EXPECT_TRUE(threadPool->tryScheduleJob(job));
+    job->wait();
+    EXPECT_EQ(1u, handlerCount);
+}
+
+TEST_P(TaskSchedulerTest, completionHandlerCalledWhenJobStops)
+{
+    auto job = std::make_shared<GateJob>();
+    std::atomic<stew::Job::Status> settledStatus = stew::Job::Status::Deferred;
+    EXPECT_TRUE(threadPool->tryScheduleJob(job));
+    EXPECT_TRUE(job->addCompletionHandler([&](stew::Job::Status status) { settledStatus = status; }));
+    job->stop();
+    EXPECT_EQ(stew::Job::Status::Stopped, settledStatus.load());
+    EXPECT_FALSE(job->addCompletionHandler([](stew::Job::Status) {}));
+}
+
+namespace
+{
+
+// Schedules an other job on the pool from its run, and waits for it or yields.
+class HelpingJob : public stew::Job
+{
+    stew::ThreadPool& m_pool;
+    bool m_yield = false;
+
+public:
+    std::shared_ptr<OrderedJob> inner;
+    std::atomic_bool innerCompletedInRun = false;
+
+    explicit HelpingJob(stew::ThreadPool& pool, std::shared_ptr<OrderedJob> inner, bool yield) :
+        m_pool(pool),
+        m_yield(yield),
+        inner(inner)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_pool.tryScheduleJob(inner);
+        if (m_yield)
+        {
+            m_pool.schedule(std::chrono::milliseconds(20));
+        }
+        else
+        {
+            inner->wait();
+        }
+        innerCompletedInRun = !inner->isBusy();
+    }
+};
+
+// Waits on the thread of the pool till a gate opens, and counts the checks of its wait condition.
+class GateWaitingJob : public stew::Job
+{
+    stew::ThreadPool& m_pool;
+
+public:
+    std::atomic_bool open = false;
+    std::atomic_size_t checkCount = 0u;
+
+    explicit GateWaitingJob(stew::ThreadPool& pool) :
+        m_pool(pool)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_pool.waitUntil([this]()
+        {
+            ++checkCount;
+            return open.load();
+        });
+    }
+};
+
+}
+
+TEST(ThreadPoolTest, waitOnWorkerRunsQueuedJobs)
+{
+    for (auto mode : {stew::ThreadPool::SchedulingMode::SharedQueue, stew::ThreadPool::SchedulingMode::WorkStealing})
+    {
+        // A single thread would deadlock if the waiting job blocked the thread.
+        stew::ThreadPool threadPool(1u);
+        threadPool.setSchedulingMode(mode);
+        threadPool.start();
+
+        std::mutex lock;
+        std::vector<int> order;
+        auto inner = std::make_shared<OrderedJob>(lock, order, 1, stew::JobPriority::Normal);
+        auto outer = std::make_shared<HelpingJob>(threadPool, inner, false);
+        EXPECT_TRUE(threadPool.tryScheduleJob(outer));
+        outer->wait();
+        EXPECT_TRUE(outer->innerCompletedInRun);
+        EXPECT_EQ(1u, order.size());
+
+        threadPool.stop();
+    }
+}
+
+TEST(ThreadPoolTest, waitOnWorkerParksWhileConditionFails)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.start();
+
+    auto waiting = std::make_shared<GateWaitingJob>(threadPool);
+    EXPECT_TRUE(threadPool.tryScheduleJob(waiting));
+    while (waiting->checkCount == 0u)
+    {
+        std::this_thread::yield();
+    }
+    // Give a spinning wait the time to check its condition over and over.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    waiting->open = true;
+    stew::ThreadPool::notifyWaiters();
+    waiting->wait();
+
+    // A parked thread checks the condition only when it gets woken.
+    EXPECT_LT(waiting->checkCount, 50u);
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, yieldOnWorkerRunsQueuedJobs)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.start();
+    EXPECT_EQ(nullptr, stew::ThreadPool::getCurrent());
+
+    std::mutex lock;
+    std::vector<int> order;
+    auto inner = std::make_shared<OrderedJob>(lock, order, 1, stew::JobPriority::Normal);
+    auto outer = std::make_shared<HelpingJob>(threadPool, inner, true);
+    EXPECT_TRUE(threadPool.tryScheduleJob(outer));
+    outer->wait();
+    EXPECT_TRUE(outer->innerCompletedInRun);
+
+    threadPool.stop();
+}
+
+TEST_P(TaskSchedulerTest, drainCompletesQueuedJobs)
+{
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool->tryScheduleJob(gate));
+    QueuedTaskScenario<TestJob> scenario(*this, 20u);
+    gate->open = true;
+
+    EXPECT_TRUE(threadPool->drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    EXPECT_FALSE(threadPool->isRunning());
+    threadPool.reset();
+    EXPECT_EQ(20u, scenario.jobCount);
+    EXPECT_FALSE(gate->isStopped());
+}
+
+TEST_P(TaskSchedulerTest, drainStopsJobsAfterDeadline)
+{
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool->tryScheduleJob(gate));
+
+    EXPECT_FALSE(threadPool->drain(stew::ThreadPool::Clock::now() + std::chrono::milliseconds(10)));
+    EXPECT_FALSE(threadPool->isRunning());
+    threadPool.reset();
+    EXPECT_TRUE(gate->isStopped());
+}
+
+TEST_P(TaskSchedulerTest, scheduleJobsMovesQueuedJobs)
+{
+    SecureInt jobCount = 0u;
+    auto queued = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool->tryScheduleJob(queued));
+
+    // Schedule more jobs than a batch holds.
+    std::vector<stew::JobPtr> jobs;
+    for (auto i = 0u; i < 100u; ++i)
+    {
+        jobs.push_back(std::make_shared<TestJob>(m_output, jobCount));
+    }
+    jobs.push_back(queued);
+    std::vector<stew::JobPtr> references = jobs;
+
+    EXPECT_EQ(100u, threadPool->tryScheduleJobs(std::move(jobs)));
+    EXPECT_EQ(101u, jobs.size());
+    EXPECT_EQ(100, std::count(jobs.begin(), jobs.end(), nullptr));
+    EXPECT_EQ(queued, jobs.back());
+
+    queued->open = true;
+    for (auto& job : references)
+    {
+        job->wait();
+    }
+    EXPECT_EQ(100u, jobCount);
+}
+
+TEST_P(TaskSchedulerTest, postRunsFunctions)
+{
+    std::atomic_size_t count = 0u;
+    for (auto i = 0u; i < 100u; ++i)
+    {
+        EXPECT_TRUE(threadPool->post([this, &count]()
+        {
+            ++count;
+            // Post from a thread of the pool.
+            threadPool->post([&count]() { ++count; });
+        }));
+    }
+
+    EXPECT_TRUE(threadPool->drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    threadPool.reset();
+    EXPECT_EQ(200u, count);
+}
+
+TEST_P(TaskSchedulerTest, postFunctionLargerThanTaskSlot)
+{
+    std::array<std::size_t, stew::ThreadPool::TaskSlotSize> payload = {};
+    payload.back() = 42u;
+    std::atomic_size_t result = 0u;
+    EXPECT_TRUE(threadPool->post([payload, &result]() { result = payload.back(); }));
+
+    EXPECT_TRUE(threadPool->drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    threadPool.reset();
+    EXPECT_EQ(42u, result);
+}
+
+TEST_P(TaskSchedulerTest, postRecyclesTaskSlots)
+{
+    // Records the address of the function, which lives in the task slot.
+    struct AddressOf
+    {
+        std::atomic<const void*>& address;
+        void operator()() const
+        {
+            address = this;
+        }
+    };
+
+    std::set<const void*> addresses;
+    for (auto i = 0u; i < 1000u; ++i)
+    {
+        std::atomic<const void*> address = nullptr;
+        ASSERT_TRUE(threadPool->post(AddressOf{address}));
+        while (!address)
+        {
+            std::this_thread::yield();
+        }
+        addresses.insert(address);
+    }
+    // The slots are allocated in chunks of 64, and the threads keep up to 64 free slots for themselves.
+    EXPECT_GE(64u * (std::thread::hardware_concurrency() + 2u), addresses.size());
+}
+
+TEST(ThreadPoolTest, restartKeepsTaskSlots)
+{
+    struct AddressOf
+    {
+        std::atomic<const void*>& address;
+        void operator()() const
+        {
+            address = this;
+        }
+    };
+
+    // The free slots of the threads go back to the pool when the threads exit, so restarting the pool
+    // does not allocate new slots.
+    stew::ThreadPool threadPool(1u);
+    std::set<const void*> addresses;
+    for (auto cycle = 0u; cycle < 20u; ++cycle)
+    {
+        threadPool.start();
+        for (auto i = 0u; i < 64u; ++i)
+        {
+            std::atomic<const void*> address = nullptr;
+            ASSERT_TRUE(threadPool.post(AddressOf{address}));
+            while (!address)
+            {
+                std::this_thread::yield();
+            }
+            addresses.insert(address);
+        }
+        threadPool.stop();
+    }
+    EXPECT_GE(2u * 64u, addresses.size());
+}
+
+TEST_P(TaskSchedulerTest, postFailsOnStoppedPool)
+{
+    threadPool->stop();
+    std::atomic_bool called = false;
+    EXPECT_FALSE(threadPool->post([&called]() { called = true; }));
+    threadPool.reset();
+    EXPECT_FALSE(called);
+}
+
+TEST_P(TaskSchedulerTest, metricsRecordJobs)
+{
+    // Let the threads park, so that the jobs wake them up.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    SecureInt jobCount = 0u;
+    std::vector<stew::JobPtr> jobs;
+    for (auto i = 0u; i < 20u; ++i)
+    {
+        jobs.push_back(std::make_shared<TestJob>(m_output, jobCount));
+        EXPECT_TRUE(threadPool->tryScheduleJob(jobs.back()));
+    }
+    for (auto& job : jobs)
+    {
+        job->wait();
+    }
+
+    auto metrics = threadPool->getMetrics();
+    EXPECT_EQ(20u, metrics.runTime.count);
+    EXPECT_EQ(20u, metrics.queueLatency.count);
+    EXPECT_LE(metrics.runTime.getPercentile(50.0), metrics.runTime.getPercentile(99.0));
+    EXPECT_LE(metrics.runTime.getPercentile(99.0), metrics.runTime.max);
+    EXPECT_LE(metrics.queueLatency.getMean(), metrics.queueLatency.max);
+    EXPECT_EQ(threadPool->getThreadCount(), metrics.threadCount);
+    ASSERT_LE(metrics.threadCount, metrics.workers.size());
+
+    std::size_t workerJobCount = 0u;
+    std::size_t wakeupCount = 0u;
+    auto idleTime = std::chrono::nanoseconds::zero();
+    for (auto& worker : metrics.workers)
+    {
+        workerJobCount += worker.jobCount;
+        wakeupCount += worker.wakeupCount;
+        idleTime += worker.idleTime;
+    }
+    EXPECT_EQ(20u, workerJobCount);
+    // A thread which parked and woke up records the time it idled.
+    ASSERT_LE(1u, wakeupCount);
+    EXPECT_LT(std::chrono::nanoseconds::zero(), idleTime);
+}
+
+TEST(ThreadPoolTest, histogramPercentiles)
+{
+    stew::ThreadPool::Histogram histogram;
+    EXPECT_EQ(std::chrono::nanoseconds::zero(), histogram.getPercentile(50.0));
+    EXPECT_EQ(std::chrono::nanoseconds::zero(), histogram.getMean());
+
+    // 90 durations from 512ns to 1023ns, and 10 durations from 1ms to 2ms.
+    histogram.buckets[10] = 90u;
+    histogram.buckets[21] = 10u;
+    histogram.count = 100u;
+    histogram.total = std::chrono::microseconds(100);
+    histogram.max = std::chrono::microseconds(1500);
+
+    EXPECT_EQ(std::chrono::nanoseconds(1023), histogram.getPercentile(50.0));
+    EXPECT_EQ(std::chrono::nanoseconds(1023), histogram.getPercentile(90.0));
+    EXPECT_EQ(std::chrono::microseconds(1500), histogram.getPercentile(99.0));
+    EXPECT_EQ(std::chrono::microseconds(1), histogram.getMean());
+}
+
+TEST(ThreadPoolTest, pollMetricsWhileStopping)
+{
+    stew::ThreadPool threadPool(4u);
+    std::atomic_bool polling = true;
+    std::thread monitor([&threadPool, &polling]()
+    {
+        while (polling)
+        {
+            auto metrics = threadPool.getMetrics();
+            EXPECT_TRUE(metrics.workers.empty() || metrics.workers.size() >= 4u);
+        }
+    });
+
+    SecureInt jobCount = 0u;
+    for (auto i = 0u; i < 50u; ++i)
+    {
+        threadPool.start();
+        EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+        threadPool.stop();
+    }
+    polling = false;
+    monitor.join();
+}
+
+TEST(ThreadPoolTest, setAffinityPolicy)
+{
+    using AffinityPolicy = stew::ThreadPool::AffinityPolicy;
+    for (auto policy : {AffinityPolicy::None, AffinityPolicy::Compact, AffinityPolicy::Scatter, AffinityPolicy::NumaNode})
+    {
+        stew::ThreadPool threadPool(2u);
+        EXPECT_EQ(AffinityPolicy::None, threadPool.getAffinityPolicy());
+        threadPool.setAffinityPolicy(policy);
+        EXPECT_EQ(policy, threadPool.getAffinityPolicy());
+        threadPool.setSchedulingMode(stew::ThreadPool::SchedulingMode::WorkStealing);
+        threadPool.start();
+
+        SecureInt jobCount = 0u;
+        auto job = std::make_shared<TestJob>(std::make_shared<Output>(), jobCount);
+        EXPECT_TRUE(threadPool.tryScheduleJob(job));
+        job->wait();
+        EXPECT_EQ(1u, jobCount);
+
+        threadPool.stop();
+    }
+}
+
+#if defined(PLATFORM_CONFIG_HOST_LINUX)
+namespace
+{
+
+// Reads the CPU affinity of the thread which runs the job.
+class AffinityJob : public stew::Job
+{
+public:
+    std::atomic_int cpuCount = 0;
+    std::atomic_bool pinnedToFirstCpu = false;
+
+protected:
+    void run() override
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        cpuCount = CPU_COUNT(&cpuSet);
+        pinnedToFirstCpu = CPU_ISSET(0, &cpuSet);
+    }
+};
+
+}
+
+TEST(ThreadPoolTest, pinThreadsToCpuList)
+{
+    stew::ThreadPool threadPool(2u);
+    threadPool.setAffinityPolicy(stew::ThreadPool::AffinityPolicy::CpuList, {0u});
+    threadPool.start();
+
+    auto job = std::make_shared<AffinityJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(job));
+    job->wait();
+    EXPECT_EQ(1, job->cpuCount);
+    EXPECT_TRUE(job->pinnedToFirstCpu);
+
+    threadPool.stop();
+}
+#endif
+
+TEST(ThreadPoolTest, elasticPoolStartsAndRetiresThreads)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.setMaxThreadCount(3u);
+    threadPool.setSpawnLatency(std::chrono::milliseconds(1));
+    threadPool.setKeepAlive(std::chrono::milliseconds(20));
+    EXPECT_EQ(3u, threadPool.getMaxThreadCount());
+    threadPool.start();
+    EXPECT_EQ(1u, threadPool.getThreadCount());
+
+    // Each gate holds a thread, so the queued gates wait till the pool starts threads for them.
+    std::vector<GateJobPtr> gates = {std::make_shared<GateJob>(), std::make_shared<GateJob>(), std::make_shared<GateJob>()};
+    for (auto& gate : gates)
+    {
+        EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+    }
+    auto isRunning = [](auto& gate) { return gate->getStatus() == stew::Job::Status::Running; };
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!std::all_of(gates.begin(), gates.end(), isRunning) && std::chrono::steady_clock::now() < timeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(std::all_of(gates.begin(), gates.end(), isRunning));
+    EXPECT_EQ(3u, threadPool.getThreadCount());
+
+    // The elastic threads retire after they idle for the keep-alive time.
+    for (auto& gate : gates)
+    {
+        gate->open = true;
+        gate->wait();
+    }
+    while (threadPool.getThreadCount() > 1u && std::chrono::steady_clock::now() < timeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(1u, threadPool.getThreadCount());
+
+    // The pool starts threads again when needed.
+    for (auto& gate : gates)
+    {
+        gate->open = false;
+        EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+    }
+    while (!std::all_of(gates.begin(), gates.end(), isRunning) && std::chrono::steady_clock::now() < timeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(std::all_of(gates.begin(), gates.end(), isRunning));
+
+    threadPool.stop();
+}
+
+namespace
+{
+
+// Blocks in a blocking scope till an other job runs, or the timeout passes.
+class BlockingJob : public stew::Job
+{
+    std::atomic_bool& m_released;
+
+public:
+    std::atomic_bool releasedInScope = false;
+
+    explicit BlockingJob(std::atomic_bool& released) :
+        m_released(released)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        stew::BlockingScope blocking;
+        const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!m_released && std::chrono::steady_clock::now() < timeout)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        releasedInScope = m_released.load();
+    }
+};
+
+// Releases the blocking job.
+class ReleasingJob : public stew::Job
+{
+    std::atomic_bool& m_released;
+
+public:
+    explicit ReleasingJob(std::atomic_bool& released) :
+        m_released(released)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_released = true;
+    }
+};
+
+}
+
+TEST(ThreadPoolTest, blockingScopeStartsCompensatingThread)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.setKeepAlive(std::chrono::milliseconds(10));
+    threadPool.start();
+
+    // The single thread of the pool blocks till the releasing job runs.
+    std::atomic_bool released = false;
+    auto blocking = std::make_shared<BlockingJob>(released);
+    EXPECT_TRUE(threadPool.tryScheduleJob(blocking));
+    while (blocking->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<ReleasingJob>(released)));
+    blocking->wait();
+    EXPECT_TRUE(blocking->releasedInScope);
+
+    // The compensating thread retires.
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (threadPool.getThreadCount() > 1u && std::chrono::steady_clock::now() < timeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(1u, threadPool.getThreadCount());
+
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, blockingScopeOutsideOfPool)
+{
+    stew::BlockingScope blocking;
+    EXPECT_EQ(nullptr, stew::ThreadPool::getCurrent());
+}
+
+namespace
+{
+
+// Starts a bounded pool with a single thread, and occupies the thread with a gate job.
+GateJobPtr startBoundedPool(stew::ThreadPool& threadPool, std::size_t capacity, stew::ThreadPool::OverflowPolicy policy)
+{
+    threadPool.setQueueCapacity(capacity);
+    threadPool.setOverflowPolicy(policy);
+    threadPool.start();
+
+    auto gate = std::make_shared<GateJob>();
+    EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+    while (gate->getStatus() != stew::Job::Status::Running)
+    {
+        std::this_thread::yield();
+    }
+    return gate;
+}
+
+}
+
+TEST(ThreadPoolTest, boundedPoolRejectsJobs)
+{
+    stew::ThreadPool threadPool(1u);
+    auto gate = startBoundedPool(threadPool, 2u, stew::ThreadPool::OverflowPolicy::Reject);
+
+    SecureInt jobCount = 0u;
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    auto rejected = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_FALSE(threadPool.tryScheduleJob(rejected));
+    EXPECT_EQ(stew::Job::Status::Deferred, rejected->getStatus());
+    EXPECT_EQ(1u, threadPool.getOverflowCount(stew::ThreadPool::OverflowPolicy::Reject));
+
+    gate->open = true;
+    EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(2u, jobCount);
+}
+
+TEST(ThreadPoolTest, boundedPoolBlocksSubmitter)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.setBlockTimeout(std::chrono::seconds(10));
+    auto gate = startBoundedPool(threadPool, 1u, stew::ThreadPool::OverflowPolicy::Block);
+
+    SecureInt jobCount = 0u;
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    std::thread opener([gate]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        gate->open = true;
+    });
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    opener.join();
+    EXPECT_EQ(1u, threadPool.getOverflowCount(stew::ThreadPool::OverflowPolicy::Block));
+
+    EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(2u, jobCount);
+}
+
+TEST(ThreadPoolTest, boundedPoolBlockTimesOut)
+{
+    stew::ThreadPool threadPool(1u);
+    threadPool.setBlockTimeout(std::chrono::milliseconds(10));
+    auto gate = startBoundedPool(threadPool, 1u, stew::ThreadPool::OverflowPolicy::Block);
+
+    SecureInt jobCount = 0u;
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    EXPECT_FALSE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+
+    gate->open = true;
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, boundedPoolRunsJobOnCaller)
+{
+    stew::ThreadPool threadPool(1u);
+    auto gate = startBoundedPool(threadPool, 1u, stew::ThreadPool::OverflowPolicy::CallerRuns);
+
+    SecureInt jobCount = 0u;
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    auto callerJob = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_TRUE(threadPool.tryScheduleJob(callerJob));
+    EXPECT_EQ(1u, jobCount);
+    EXPECT_FALSE(callerJob->isBusy());
+    EXPECT_EQ(1u, threadPool.getOverflowCount(stew::ThreadPool::OverflowPolicy::CallerRuns));
+
+    gate->open = true;
+    EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(2u, jobCount);
+}
+
+TEST(ThreadPoolTest, boundedPoolQueuesTimedJobOnItsThreads)
+{
+    stew::ThreadPool threadPool(1u);
+    auto gate = startBoundedPool(threadPool, 1u, stew::ThreadPool::OverflowPolicy::CallerRuns);
+
+    SecureInt jobCount = 0u;
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+    // The timer neither runs the due job on its thread, nor drops it, when the queues are full.
+    auto timedJob = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_TRUE(threadPool.scheduleAfter(timedJob, std::chrono::milliseconds(1)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(0u, jobCount);
+    EXPECT_EQ(0u, threadPool.getOverflowCount(stew::ThreadPool::OverflowPolicy::CallerRuns));
+
+    gate->open = true;
+    while (jobCount < 2u)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, boundedPoolDropsOldestJob)
+{
+    stew::ThreadPool threadPool(1u);
+    auto gate = startBoundedPool(threadPool, 1u, stew::ThreadPool::OverflowPolicy::DropOldest);
+
+    SecureInt jobCount = 0u;
+    auto oldest = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_TRUE(threadPool.tryScheduleJob(oldest));
+    auto newest = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_TRUE(threadPool.tryScheduleJob(newest));
+    EXPECT_TRUE(oldest->isStopped());
+    EXPECT_EQ(1u, threadPool.getOverflowCount(stew::ThreadPool::OverflowPolicy::DropOldest));
+
+    gate->open = true;
+    newest->wait();
+    EXPECT_EQ(1u, jobCount);
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, boundedPoolKeepsJobsWhenQueuedJobGetsRescheduled)
+{
+    stew::ThreadPool threadPool(1u);
+    auto gate = startBoundedPool(threadPool, 2u, stew::ThreadPool::OverflowPolicy::DropOldest);
+
+    SecureInt jobCount = 0u;
+    auto oldest = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_TRUE(threadPool.tryScheduleJob(oldest));
+    auto queued = std::make_shared<TestJob>(nullptr, jobCount);
+    EXPECT_TRUE(threadPool.tryScheduleJob(queued));
+    // Rescheduling the queued job on the full queues drops no job.
+    EXPECT_FALSE(threadPool.tryScheduleJob(queued));
+    EXPECT_FALSE(oldest->isStopped());
+    EXPECT_FALSE(queued->isStopped());
+    EXPECT_EQ(0u, threadPool.getOverflowCount(stew::ThreadPool::OverflowPolicy::DropOldest));
+
+    gate->open = true;
+    EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(2u, jobCount);
+}
+
+TEST(ThreadPoolTest, boundedPoolDropsOldestDeadlineJob)
+{
+    stew::ThreadPool threadPool(1u);
+    auto gate = startBoundedPool(threadPool, 2u, stew::ThreadPool::OverflowPolicy::DropOldest);
+
+    // The queues hold jobs with a deadline only, the oldest one gets dropped, not the earliest due.
+    SecureInt jobCount = 0u;
+    const auto now = stew::ThreadPool::Clock::now();
+    auto oldest = std::make_shared<TestJob>(nullptr, jobCount);
+    oldest->setDeadline(now + std::chrono::hours(2));
+    EXPECT_TRUE(threadPool.tryScheduleJob(oldest));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto earliest = std::make_shared<TestJob>(nullptr, jobCount);
+    earliest->setDeadline(now + std::chrono::hours(1));
+    EXPECT_TRUE(threadPool.tryScheduleJob(earliest));
+    auto newest = std::make_shared<TestJob>(nullptr, jobCount);
+    newest->setDeadline(now + std::chrono::hours(3));
+    EXPECT_TRUE(threadPool.tryScheduleJob(newest));
+    EXPECT_TRUE(oldest->isStopped());
+    EXPECT_FALSE(earliest->isStopped());
+    EXPECT_EQ(2u, threadPool.getQueuedJobs());
+
+    gate->open = true;
+    earliest->wait();
+    newest->wait();
+    EXPECT_EQ(2u, jobCount);
+    threadPool.stop();
+}
+
+TEST(ThreadPoolTest, idleSpinningStrategies)
+{
+    for (auto [spinCount, yieldCount] : {std::pair<std::size_t, std::size_t>{0u, 0u}, {100u, 10u}, {1000000u, 0u}, {0u, 1000000u}})
+    {
+        stew::ThreadPool threadPool(2u);
+        threadPool.setIdleSpinning(spinCount, yieldCount);
+        EXPECT_EQ(spinCount, threadPool.getIdleSpinCount());
+        EXPECT_EQ(yieldCount, threadPool.getIdleYieldCount());
+        threadPool.start();
+
+        SecureInt jobCount = 0u;
+        std::vector<stew::JobPtr> jobs;
+        for (auto i = 0u; i < 10u; ++i)
+        {
+            jobs.push_back(std::make_shared<TestJob>(nullptr, jobCount));
+            EXPECT_TRUE(threadPool.tryScheduleJob(jobs.back()));
+            std::this_thread::yield();
+        }
+        for (auto& job : jobs)
+        {
+            job->wait();
+        }
+        EXPECT_EQ(10u, jobCount);
+
+        // The spinning threads stop spinning when the pool stops.
+        threadPool.stop();
+    }
+}
+
+TEST(MpmcQueueTest, boundedFifo)
+{
+    stew::MpmcQueue<int> queue(3u);
+    EXPECT_EQ(4u, queue.getCapacity());
+    EXPECT_TRUE(queue.wasEmpty());
+    EXPECT_EQ(0, queue.tryPop());
+
+    for (auto i = 1; i <= 4; ++i)
+    {
+        EXPECT_TRUE(queue.tryPush(int(i)));
+    }
+    EXPECT_FALSE(queue.tryPush(5));
+    EXPECT_FALSE(queue.wasEmpty());
+
+    for (auto i = 1; i <= 4; ++i)
+    {
+        EXPECT_EQ(i, queue.tryPop());
+    }
+    EXPECT_TRUE(queue.wasEmpty());
+    EXPECT_TRUE(queue.tryPush(6));
+    EXPECT_EQ(6, queue.tryPop());
+}
+
+TEST(MpmcQueueTest, concurrentProducersAndConsumers)
+{
+    constexpr std::size_t ThreadCount = 4u;
+    constexpr std::size_t ElementCount = 10000u;
+    stew::MpmcQueue<std::size_t> queue(64u);
+
+    std::atomic_size_t sum = 0u;
+    std::atomic_size_t popCount = 0u;
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0u; t < ThreadCount; ++t)
+    {
+        threads.emplace_back([&queue, t]()
+        {
+            for (auto i = t * ElementCount + 1u; i <= (t + 1u) * ElementCount; ++i)
+            {
+                while (!queue.tryPush(std::size_t(i)))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        threads.emplace_back([&queue, &sum, &popCount]()
+        {
+            while (popCount < ThreadCount * ElementCount)
+            {
+                if (auto value = queue.tryPop(); value)
+                {
+                    sum += value;
+                    ++popCount;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    const auto count = ThreadCount * ElementCount;
+    EXPECT_EQ(count * (count + 1u) / 2u, sum);
+    EXPECT_TRUE(queue.wasEmpty());
+}
+
+TEST_P(TaskSchedulerTest, manyExternalSubmitters)
+{
+    constexpr std::size_t SubmitterCount = 8u;
+    constexpr std::size_t JobCount = 500u;
+
+    SecureInt jobCount = 0u;
+    std::vector<std::thread> submitters;
+    for (std::size_t i = 0u; i < SubmitterCount; ++i)
+    {
+        submitters.emplace_back([this, &jobCount]()
+        {
+            for (std::size_t j = 0u; j < JobCount; ++j)
+            {
+                EXPECT_TRUE(threadPool->tryScheduleJob(std::make_shared<TestJob>(nullptr, jobCount)));
+            }
+        });
+    }
+    for (auto& submitter : submitters)
+    {
+        submitter.join();
+    }
+
+    const auto timeout = stew::ThreadPool::Clock::now() + std::chrono::seconds(30);
+    while (jobCount < SubmitterCount * JobCount && stew::ThreadPool::Clock::now() < timeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(SubmitterCount * JobCount, jobCount);
+}
+
+TEST_P(TaskSchedulerTest, stopWhileSubmittersSchedule)
+{
+    constexpr std::size_t SubmitterCount = 4u;
+    constexpr std::size_t BatchSize = 8u;
+
+    // The submitters schedule till the pool gets stopped, half of them in batches.
+    SecureInt jobCount = 0u;
+    std::vector<std::vector<stew::JobPtr>> submittedJobs(SubmitterCount);
+    std::vector<std::thread> submitters;
+    for (std::size_t i = 0u; i < SubmitterCount; ++i)
+    {
+        submitters.emplace_back([this, &jobCount, &jobs = submittedJobs[i], batched = (i % 2u == 1u)]()
+        {
+            while (true)
+            {
+                std::vector<stew::JobPtr> batch;
+                for (std::size_t j = 0u; j < (batched ? BatchSize : 1u); ++j)
+                {
+                    batch.push_back(std::make_shared<TestJob>(nullptr, jobCount));
+                }
+                jobs.insert(jobs.end(), batch.begin(), batch.end());
+                const auto scheduled = batched ? threadPool->tryScheduleJobs(batch) : std::size_t(threadPool->tryScheduleJob(batch.front()));
+                if (scheduled == 0u)
+                {
+                    break;
+                }
+            }
+        });
+    }
+
+    const auto timeout = stew::ThreadPool::Clock::now() + std::chrono::seconds(5);
+    while (jobCount < 1000u && stew::ThreadPool::Clock::now() < timeout)
+    {
+        std::this_thread::yield();
+    }
+    threadPool->stop();
+    for (auto& submitter : submitters)
+    {
+        submitter.join();
+    }
+    threadPool.reset();
+
+    // No job remains queued: the jobs either completed, or got stopped.
+    for (auto& jobs : submittedJobs)
+    {
+        for (auto& job : jobs)
+        {
+            const auto status = job->getStatus();
+            EXPECT_TRUE(status == stew::Job::Status::Deferred || status == stew::Job::Status::Stopped);
+        }
+    }
+}
+
+namespace
+{
+
+// Schedules its successor from the thread of the pool, till the last link of the chain.
+class ChainJob : public stew::Job
+{
+    stew::ThreadPool& m_pool;
+    std::mutex& m_lock;
+    std::vector<int>& m_order;
+    int m_id = 0;
+    int m_last = 0;
+
+public:
+    explicit ChainJob(stew::ThreadPool& pool, std::mutex& lock, std::vector<int>& order, int id, int last) :
+        m_pool(pool),
+        m_lock(lock),
+        m_order(order),
+        m_id(id),
+        m_last(last)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_order.push_back(m_id);
+        }
+        if (m_id < m_last)
+        {
+            m_pool.tryScheduleJob(std::make_shared<ChainJob>(m_pool, m_lock, m_order, m_id + 1, m_last));
+        }
+    }
+};
+
+}
+
+TEST(ThreadPoolTest, nextJobSlotRunsContinuationFirst)
+{
+    for (auto [limit, expected] : {std::pair<std::size_t, std::vector<int>>{3u, {1, 2, 3, 4, 100, 5, 6}}, {0u, {1, 100, 2, 3, 4, 5, 6}}})
+    {
+        stew::ThreadPool threadPool(1u);
+        threadPool.setNextJobSlotLimit(limit);
+        EXPECT_EQ(limit, threadPool.getNextJobSlotLimit());
+        threadPool.start();
+
+        auto gate = std::make_shared<GateJob>();
+        EXPECT_TRUE(threadPool.tryScheduleJob(gate));
+        while (gate->getStatus() != stew::Job::Status::Running)
+        {
+            std::this_thread::yield();
+        }
+
+        std::mutex lock;
+        std::vector<int> order;
+        EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<ChainJob>(threadPool, lock, order, 1, 6)));
+        EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<OrderedJob>(lock, order, 100, stew::JobPriority::Normal)));
+
+        gate->open = true;
+        EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+        EXPECT_EQ(expected, order);
+    }
+}
+
+namespace
+{
+
+// Schedules its successor from the thread of the pool, and records the threads which ran the links.
+class ThreadChainJob : public stew::Job
+{
+    stew::ThreadPool& m_pool;
+    std::vector<std::thread::id>& m_threads;
+    int m_remaining = 0;
+
+public:
+    explicit ThreadChainJob(stew::ThreadPool& pool, std::vector<std::thread::id>& threads, int remaining) :
+        m_pool(pool),
+        m_threads(threads),
+        m_remaining(remaining)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        // The links run one after the other.
+        m_threads.push_back(std::this_thread::get_id());
+        if (m_remaining > 0)
+        {
+            m_pool.tryScheduleJob(std::make_shared<ThreadChainJob>(m_pool, m_threads, m_remaining - 1));
+        }
+    }
+};
+
+}
+
+TEST(ThreadPoolTest, nextJobSlotKeepsChainOnItsThread)
+{
+    stew::ThreadPool threadPool(4u);
+    threadPool.setNextJobSlotLimit(100u);
+    threadPool.start();
+    // Let the threads park.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::vector<std::thread::id> threads;
+    EXPECT_TRUE(threadPool.tryScheduleJob(std::make_shared<ThreadChainJob>(threadPool, threads, 50)));
+    EXPECT_TRUE(threadPool.drain(stew::ThreadPool::Clock::now() + std::chrono::seconds(10)));
+
+    ASSERT_EQ(51u, threads.size());
+    // No parked thread got woken to steal the links of the chain.
+    EXPECT_EQ(threads.size(), static_cast<std::size_t>(std::count(threads.begin(), threads.end(), threads.front())));
+}
@@ -33,6 +33,11 @@ protected:
     {
         auto arguments = stew::LibraryArguments();
         arguments.threadPool.createThreadPool = multiThreaded;
+        initializeDomain(arguments, mockTracePrinter);
+    }
+
+    void initializeDomain(const stew::LibraryArguments& arguments, bool mockTracePrinter)
+    {
         stew::Library::instance().initialize(arguments);
 
         if (mockTracePrinter)